@@ -0,0 +1,188 @@
+#include "bitboard.h"
+
+Bitboard knight_attacks[64];
+Bitboard king_attacks[64];
+Bitboard pawn_attacks[2][64];
+
+SliderEntry rook_entries[64];
+SliderEntry bishop_entries[64];
+
+Bitboard between_bb[64][64];
+Bitboard line_bb[64][64];
+
+// Sum over all squares of 2^(relevant occupancy bits)
+static Bitboard rook_table[102400];
+static Bitboard bishop_table[5248];
+
+static inline bool is_on_board(Position pos) {
+    return pos.col >= 0 && pos.col < 8 && pos.row >= 0 && pos.row < 8;
+}
+
+static inline Position step(Position pos, Direction dir) {
+    return (Position) { .col = pos.col + dir.col, .row = pos.row + dir.row };
+}
+
+static Bitboard jump_attacks(Square square, const Direction* directions, size_t nb_directions) {
+    Bitboard attacks = 0;
+    for (size_t i = 0; i < nb_directions; i++) {
+        const Position aimed_cell = step(position_of(square), directions[i]);
+        if (is_on_board(aimed_cell)) attacks |= square_bb(square_of(aimed_cell));
+    }
+    return attacks;
+}
+
+// Slow ray walk, only used to fill the lookup tables.
+static Bitboard ray_attacks(Square square, Bitboard occupied, const Direction* directions) {
+    Bitboard attacks = 0;
+    for (size_t i = 0; i < 4; i++) {
+        Position aimed_cell = step(position_of(square), directions[i]);
+        while (is_on_board(aimed_cell)) {
+            attacks |= square_bb(square_of(aimed_cell));
+            if (occupied & square_bb(square_of(aimed_cell))) break;
+            aimed_cell = step(aimed_cell, directions[i]);
+        }
+    }
+    return attacks;
+}
+
+// Same as `ray_attacks` on an empty board, minus the last square of each ray:
+// whatever sits there cannot block anything.
+static Bitboard ray_mask(Square square, const Direction* directions) {
+    Bitboard mask = 0;
+    for (size_t i = 0; i < 4; i++) {
+        Position aimed_cell = step(position_of(square), directions[i]);
+        while (is_on_board(step(aimed_cell, directions[i]))) {
+            mask |= square_bb(square_of(aimed_cell));
+            aimed_cell = step(aimed_cell, directions[i]);
+        }
+    }
+    return mask;
+}
+
+static void init_slider_entries(SliderEntry* entries, Bitboard* table, const Direction* directions) {
+    static Bitboard occupancies[4096];
+    static Bitboard references[4096];
+
+#ifndef __BMI2__
+    static u32 epoch[4096];
+    u32 attempt = 0;
+    u64 seed = 0x5EED5EED5EED5EEDull;
+#endif
+
+    for (Square square = 0; square < 64; square++) {
+        SliderEntry* entry = &entries[square];
+        entry->mask = ray_mask(square, directions);
+        entry->shift = 64 - popcount(entry->mask);
+        entry->attacks = table;
+        table += 1ull << popcount(entry->mask);
+
+        // Enumerate every subset of the mask (Carry-Rippler trick)
+        size_t nb_subsets = 0;
+        Bitboard subset = 0;
+        do {
+            occupancies[nb_subsets] = subset;
+            references[nb_subsets] = ray_attacks(square, subset, directions);
+            nb_subsets++;
+            subset = (subset - entry->mask) & entry->mask;
+        } while (subset);
+
+#ifdef __BMI2__
+        for (size_t i = 0; i < nb_subsets; i++)
+            entry->attacks[slider_index(entry, occupancies[i])] = references[i];
+#else
+        // Try sparse random numbers until one maps every subset without
+        // destructive collisions.
+        size_t i;
+        do {
+            do {
+                entry->magic = random_u64(&seed) & random_u64(&seed) & random_u64(&seed);
+            } while (popcount((entry->mask * entry->magic) >> 56) < 6);
+
+            attempt++;
+            for (i = 0; i < nb_subsets; i++) {
+                const size_t index = slider_index(entry, occupancies[i]);
+                if (epoch[index] < attempt) {
+                    epoch[index] = attempt;
+                    entry->attacks[index] = references[i];
+                } else if (entry->attacks[index] != references[i]) {
+                    break;
+                }
+            }
+        } while (i < nb_subsets);
+#endif
+    }
+}
+
+__attribute__((constructor))
+static void init_bitboards(void) {
+    const Direction knight_directions[] = {
+        { .col =  2, .row =  1 }, { .col =  2, .row = -1 }, { .col = -2, .row =  1 }, { .col = -2, .row = -1 },
+        { .col =  1, .row =  2 }, { .col = -1, .row =  2 }, { .col =  1, .row = -2 }, { .col = -1, .row = -2 },
+    };
+    const Direction king_directions[] = { DIR_N, DIR_S, DIR_E, DIR_W, DIR_NE, DIR_NW, DIR_SE, DIR_SW };
+    const Direction white_pawn_directions[] = { DIR_NE, DIR_NW };
+    const Direction black_pawn_directions[] = { DIR_SE, DIR_SW };
+
+    for (Square square = 0; square < 64; square++) {
+        knight_attacks[square] = jump_attacks(square, knight_directions, 8);
+        king_attacks[square] = jump_attacks(square, king_directions, 8);
+        pawn_attacks[WHITE][square] = jump_attacks(square, white_pawn_directions, 2);
+        pawn_attacks[BLACK][square] = jump_attacks(square, black_pawn_directions, 2);
+    }
+
+    const Direction rook_directions[] = { DIR_N, DIR_S, DIR_E, DIR_W };
+    const Direction bishop_directions[] = { DIR_NE, DIR_NW, DIR_SE, DIR_SW };
+    init_slider_entries(rook_entries, rook_table, rook_directions);
+    init_slider_entries(bishop_entries, bishop_table, bishop_directions);
+
+    for (Square a = 0; a < 64; a++) {
+        for (Square b = 0; b < 64; b++) {
+            if (a == b) continue;
+            const Bitboard ends = square_bb(a) | square_bb(b);
+
+            if (rook_attacks(a, 0) & square_bb(b)) {
+                line_bb[a][b] = (rook_attacks(a, 0) & rook_attacks(b, 0)) | ends;
+                between_bb[a][b] = rook_attacks(a, square_bb(b)) & rook_attacks(b, square_bb(a));
+            } else if (bishop_attacks(a, 0) & square_bb(b)) {
+                line_bb[a][b] = (bishop_attacks(a, 0) & bishop_attacks(b, 0)) | ends;
+                between_bb[a][b] = bishop_attacks(a, square_bb(b)) & bishop_attacks(b, square_bb(a));
+            }
+        }
+    }
+}
+
+Cell bitboards_piece_at(const Bitboards* bitboards, Square square) {
+    const Bitboard bb = square_bb(square);
+    if (!(bitboards->occupied & bb)) return EMPTY_CELL;
+
+    const PieceColor color = bitboards->colors[WHITE] & bb ? WHITE : BLACK;
+    PiecesType type = PAWN;
+    while (!(bitboards->pieces[color][type] & bb)) type++;
+    return (Cell) { color, type };
+}
+
+void bitboards_from_chess_board(ChessBoard board, Bitboards* output) {
+    *output = (Bitboards) {0};
+    for (Square square = 0; square < 64; square++) {
+        const Position pos = position_of(square);
+        const Cell piece = board[pos.row][pos.col];
+        if (!piece.is_empty) bitboards_put_piece(output, square, piece);
+    }
+}
+
+void bitboards_to_chess_board(const Bitboards* bitboards, ChessBoard output) {
+    for (Square square = 0; square < 64; square++) {
+        const Position pos = position_of(square);
+        output[pos.row][pos.col] = bitboards_piece_at(bitboards, square);
+    }
+}
+
+void attack_maps_from_bitboards(const Bitboards* bitboards, AttackMaps* output) {
+    *output = (AttackMaps) {0};
+    Bitboard occupied = bitboards->occupied;
+    while (occupied) {
+        const Square square = pop_lsb(&occupied);
+        const Cell piece = bitboards_piece_at(bitboards, square);
+        attack_maps_add(output, piece.color, piece_attacks(piece, square, bitboards->occupied));
+    }
+}
@@ -0,0 +1,183 @@
+// vim:ft=c
+#pragma once
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "common_types.h"
+
+// One bit per square. Squares are numbered `row * 8 + col`, so they follow the
+// same layout as `ChessBoard` (square 0 is the top-left corner, black's side).
+typedef u64 Bitboard;
+typedef u8 Square;
+
+typedef struct {
+    Bitboard pieces[2][6];  // [PieceColor][PiecesType]
+    Bitboard colors[2];
+    Bitboard occupied;
+} Bitboards;
+
+// What each color attacks, and with how many pieces. Sliders stop at the first
+// piece in their way, whatever its color.
+//
+// The counts are bit-sliced: bit `i` of the count of a square is in
+// `counts[color][i]`. Adding or removing every attack of a piece at once is
+// then a few bitwise operations, instead of one increment per square.
+#define ATTACK_COUNT_BITS 5
+
+typedef struct {
+    Bitboard counts[2][ATTACK_COUNT_BITS];  // [PieceColor][bit]
+} AttackMaps;
+
+typedef struct {
+    Bitboard mask;   // relevant occupancy, board edges excluded
+    Bitboard magic;  // unused when indexing with PEXT
+    Bitboard* attacks;
+    u8 shift;
+} SliderEntry;
+
+extern Bitboard knight_attacks[64];
+extern Bitboard king_attacks[64];
+extern Bitboard pawn_attacks[2][64];
+
+extern SliderEntry rook_entries[64];
+extern SliderEntry bishop_entries[64];
+
+// Cells strictly between two aligned squares, and the whole line through
+// them. Both are empty when the squares aren't on the same line.
+extern Bitboard between_bb[64][64];
+extern Bitboard line_bb[64][64];
+
+#define ROW_BB(row) (0xFFull << ((row) * 8))
+#define COL_BB(col) (0x0101010101010101ull << (col))
+
+static inline Square square_of(Position pos) { return pos.row * 8 + pos.col; }
+
+static inline Position position_of(Square square) {
+    return (Position) { .col = square & 7, .row = square >> 3 };
+}
+
+static inline Bitboard square_bb(Square square) { return 1ull << square; }
+
+static inline Square lsb(Bitboard bb) { return __builtin_ctzll(bb); }
+
+static inline Square pop_lsb(Bitboard* bb) {
+    const Square square = lsb(*bb);
+    *bb &= *bb - 1;
+    return square;
+}
+
+static inline u8 popcount(Bitboard bb) { return __builtin_popcountll(bb); }
+
+// xorshift64*, only used to fill tables at startup so they are the same on
+// every run.
+static inline u64 random_u64(u64* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1Dull;
+}
+
+static inline size_t slider_index(const SliderEntry* entry, Bitboard occupied) {
+#ifdef __BMI2__
+    return _pext_u64(occupied, entry->mask);
+#else
+    return ((occupied & entry->mask) * entry->magic) >> entry->shift;
+#endif
+}
+
+static inline Bitboard rook_attacks(Square square, Bitboard occupied) {
+    const SliderEntry* entry = &rook_entries[square];
+    return entry->attacks[slider_index(entry, occupied)];
+}
+
+static inline Bitboard bishop_attacks(Square square, Bitboard occupied) {
+    const SliderEntry* entry = &bishop_entries[square];
+    return entry->attacks[slider_index(entry, occupied)];
+}
+
+static inline Bitboard queen_attacks(Square square, Bitboard occupied) {
+    return rook_attacks(square, occupied) | bishop_attacks(square, occupied);
+}
+
+// Cells attacked by a piece, which for pawns excludes their pushes
+static inline Bitboard piece_attacks(Cell piece, Square square, Bitboard occupied) {
+    switch (piece.type) {
+        case PAWN:   return pawn_attacks[piece.color][square];
+        case ROOK:   return rook_attacks(square, occupied);
+        case KNIGHT: return knight_attacks[square];
+        case BISHOP: return bishop_attacks(square, occupied);
+        case QWEEN:  return queen_attacks(square, occupied);
+        case KING:   return king_attacks[square];
+    }
+    return 0;
+}
+
+// All pieces of `attacker_color` that attack `square`, given some occupancy.
+static inline Bitboard attackers_to(const Bitboards* bitboards, Square square, PieceColor attacker_color, Bitboard occupied) {
+    const Bitboard* pieces = bitboards->pieces[attacker_color];
+    const Bitboard rooks   = pieces[ROOK]   | pieces[QWEEN];
+    const Bitboard bishops = pieces[BISHOP] | pieces[QWEEN];
+
+    // A pawn of `attacker_color` attacks `square` if a pawn of the other color
+    // on `square` would attack it back.
+    return (pawn_attacks[attacker_color ^ 1][square] & pieces[PAWN])
+        | (knight_attacks[square] & pieces[KNIGHT])
+        | (king_attacks[square] & pieces[KING])
+        | (rook_attacks(square, occupied) & rooks)
+        | (bishop_attacks(square, occupied) & bishops);
+}
+
+static inline bool is_square_attacked(const Bitboards* bitboards, Square square, PieceColor attacker_color) {
+    return attackers_to(bitboards, square, attacker_color, bitboards->occupied) != 0;
+}
+
+static inline void bitboards_put_piece(Bitboards* bitboards, Square square, Cell piece) {
+    const Bitboard bb = square_bb(square);
+    bitboards->pieces[piece.color][piece.type] |= bb;
+    bitboards->colors[piece.color] |= bb;
+    bitboards->occupied |= bb;
+}
+
+static inline void bitboards_remove_piece(Bitboards* bitboards, Square square, Cell piece) {
+    const Bitboard bb = square_bb(square);
+    bitboards->pieces[piece.color][piece.type] &= ~bb;
+    bitboards->colors[piece.color] &= ~bb;
+    bitboards->occupied &= ~bb;
+}
+
+// Adds one to the count of every square, carries ripple up the bits
+static inline void attack_maps_add(AttackMaps* maps, PieceColor color, Bitboard squares) {
+    Bitboard* counts = maps->counts[color];
+    for (size_t i = 0; i < ATTACK_COUNT_BITS; i++) {
+        const Bitboard carry = counts[i] & squares;
+        counts[i] ^= squares;
+        squares = carry;
+    }
+}
+
+static inline void attack_maps_remove(AttackMaps* maps, PieceColor color, Bitboard squares) {
+    Bitboard* counts = maps->counts[color];
+    for (size_t i = 0; i < ATTACK_COUNT_BITS; i++) {
+        const Bitboard borrow = ~counts[i] & squares;
+        counts[i] ^= squares;
+        squares = borrow;
+    }
+}
+
+static inline Bitboard attacked_squares(const AttackMaps* maps, PieceColor color) {
+    const Bitboard* counts = maps->counts[color];
+    return counts[0] | counts[1] | counts[2] | counts[3] | counts[4];
+}
+
+static inline u8 attack_count(const AttackMaps* maps, PieceColor color, Square square) {
+    u8 count = 0;
+    for (size_t i = 0; i < ATTACK_COUNT_BITS; i++) count |= (maps->counts[color][i] >> square & 1) << i;
+    return count;
+}
+
+Cell bitboards_piece_at(const Bitboards* bitboards, Square square);
+void bitboards_from_chess_board(ChessBoard board, Bitboards* output);
+void bitboards_to_chess_board(const Bitboards* bitboards, ChessBoard output);
+void attack_maps_from_bitboards(const Bitboards* bitboards, AttackMaps* output);
@@ -0,0 +1,39 @@
+// vim:ft=c
+#pragma once
+
+#include "lib.h"
+
+// Polyglot keys hash 12 kinds of pieces on 64 squares, the castling rights,
+// the en passant column and the side to move.
+#define POLYGLOT_NB_RANDOMS 781
+
+// One entry of a `.bin` book, stored big endian, sorted by key
+typedef struct {
+    u64 key;
+    u16 move;
+    u16 weight;
+    u32 learn;
+} PolyglotEntry;
+
+typedef struct {
+    Move move;
+    u16 weight;
+} BookMove;
+
+typedef struct {
+    const PolyglotEntry* entries;  // Mapped file
+    size_t nb_entries;
+} OpeningBook;
+
+OpeningBook* book_open(const char* path);
+void book_close(OpeningBook* book);
+
+u64 polyglot_key(const GameState* state);
+
+// Like `get_possible_moves`, but only the book moves for the current position,
+// best weight first. Moves that aren't legal are left out.
+size_t get_book_moves(const OpeningBook* book, const GameState* state, BookMove* output, size_t max_moves);
+
+// Weighted pick between the book moves, `random` being any random number.
+// Returns false out of book.
+bool pick_book_move(const OpeningBook* book, const GameState* state, u64 random, Move* output);
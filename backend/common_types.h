@@ -37,15 +37,18 @@ typedef struct {
 } Position;
 typedef Position Direction;
 
-const Direction DIR_N = { .col =  0, .row = -1 };
-const Direction DIR_S = { .col =  0, .row =  1 };
-const Direction DIR_E = { .col =  1, .row =  0 };
-const Direction DIR_W = { .col = -1, .row =  0 };
-
-const Direction DIR_NE = { .col =  1, .row = -1 };
-const Direction DIR_NW = { .col = -1, .row = -1 };
-const Direction DIR_SE = { .col =  1, .row =  1 };
-const Direction DIR_SW = { .col = -1, .row =  1 };
+// Enough for a qween in the middle of the board
+#define MAX_PIECE_MOVES 32
+
+static const Direction DIR_N = { .col =  0, .row = -1 };
+static const Direction DIR_S = { .col =  0, .row =  1 };
+static const Direction DIR_E = { .col =  1, .row =  0 };
+static const Direction DIR_W = { .col = -1, .row =  0 };
+
+static const Direction DIR_NE = { .col =  1, .row = -1 };
+static const Direction DIR_NW = { .col = -1, .row = -1 };
+static const Direction DIR_SE = { .col =  1, .row =  1 };
+static const Direction DIR_SW = { .col = -1, .row =  1 };
 
 
 
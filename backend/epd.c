@@ -0,0 +1,149 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "epd.h"
+#include "fen.h"
+
+// Threads grab chunks of the file as they go, so a slow chunk doesn't keep
+// the others waiting.
+#define CHUNK_SIZE (4 << 20)
+
+#define MAX_THREADS 256
+
+// A FEN never needs that much, longer lines only get their operations cut
+#define LINE_BUFFER_SIZE 256
+
+typedef struct {
+    const char* data;
+    size_t size;
+    u64 next_chunk;  // Only touched atomically
+    EpdCallback callback;
+    void* user_data;
+} EpdFile;
+
+typedef struct {
+    EpdFile* file;
+    u16 index;
+    EpdStats stats;
+    GameState state;  // Reused for every line
+} EpdReader;
+
+static void read_line(EpdReader* reader, const char* line, size_t length, u64 offset) {
+    while (length && (line[length - 1] == '\r' || line[length - 1] == ' ')) length--;
+    if (length == 0 || line[0] == '#') return;
+    reader->stats.nb_lines++;
+
+    // The mapped file has no NUL after the line, the parser needs one
+    char buffer[LINE_BUFFER_SIZE];
+    const size_t copied = length < LINE_BUFFER_SIZE - 1 ? length : LINE_BUFFER_SIZE - 1;
+    memcpy(buffer, line, copied);
+    buffer[copied] = '\0';
+
+    const char* operations;
+    if (!load_epd(&reader->state, buffer, &operations)) {
+        reader->stats.nb_invalid++;
+        return;
+    }
+
+    reader->stats.nb_positions++;
+    if (reader->file->callback == NULL) return;
+    const size_t operations_offset = operations - buffer;
+    reader->file->callback(reader->file->user_data, reader->index, offset, &reader->state,
+                           line + operations_offset, length - operations_offset);
+}
+
+// A chunk owns the lines that start inside it, even if they end past it
+static void read_chunk(EpdReader* reader, size_t start, size_t end) {
+    const char* data = reader->file->data;
+    const size_t size = reader->file->size;
+
+    if (start > 0) {
+        const char* newline = memchr(data + start - 1, '\n', size - start + 1);
+        if (newline == NULL) return;
+        start = newline - data + 1;
+    }
+
+    while (start < end) {
+        const char* newline = memchr(data + start, '\n', size - start);
+        const size_t line_end = newline ? (size_t) (newline - data) : size;
+        read_line(reader, data + start, line_end - start, start);
+        start = line_end + 1;
+    }
+}
+
+static void* reader_main(void* arg) {
+    EpdReader* reader = arg;
+    EpdFile* file = reader->file;
+
+    while (true) {
+        const u64 chunk = __atomic_fetch_add(&file->next_chunk, 1, __ATOMIC_RELAXED);
+        const size_t start = chunk * CHUNK_SIZE;
+        if (start >= file->size) break;
+
+        const size_t end = start + CHUNK_SIZE < file->size ? start + CHUNK_SIZE : file->size;
+        read_chunk(reader, start, end);
+        reader->stats.nb_bytes += end - start;
+    }
+
+    return NULL;
+}
+
+bool read_epd_file(const char* path, u16 nb_threads, EpdCallback callback, void* user_data, EpdStats* stats) {
+    *stats = (EpdStats) {0};
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return false;
+    }
+    if (file_stat.st_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    const size_t size = file_stat.st_size;
+    const char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    madvise((void*) data, size, MADV_SEQUENTIAL);
+
+    if (nb_threads == 0) nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nb_threads > MAX_THREADS) nb_threads = MAX_THREADS;
+    const size_t nb_chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (nb_threads > nb_chunks) nb_threads = nb_chunks;
+
+    EpdFile file = { .data = data, .size = size, .callback = callback, .user_data = user_data };
+    EpdReader* readers = calloc(nb_threads, sizeof(EpdReader));
+    if (readers == NULL) {
+        munmap((void*) data, size);
+        return false;
+    }
+
+    // The calling thread reads too, as reader 0
+    pthread_t threads[MAX_THREADS];
+    bool started[MAX_THREADS] = {0};
+    for (u16 i = 0; i < nb_threads; i++) readers[i] = (EpdReader) { .file = &file, .index = i };
+    for (u16 i = 1; i < nb_threads; i++)
+        started[i] = pthread_create(&threads[i], NULL, reader_main, &readers[i]) == 0;
+    reader_main(&readers[0]);
+
+    for (u16 i = 0; i < nb_threads; i++) {
+        if (i > 0 && started[i]) pthread_join(threads[i], NULL);
+        stats->nb_lines += readers[i].stats.nb_lines;
+        stats->nb_positions += readers[i].stats.nb_positions;
+        stats->nb_invalid += readers[i].stats.nb_invalid;
+        stats->nb_bytes += readers[i].stats.nb_bytes;
+    }
+
+    free(readers);
+    munmap((void*) data, size);
+    return true;
+}
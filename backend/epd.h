@@ -0,0 +1,22 @@
+// vim:ft=c
+#pragma once
+
+#include "lib.h"
+
+// Called once per valid position, from the reading threads. `state` is only
+// valid during the call, and `operations` points into the mapped file, it isn't
+// NUL terminated.
+typedef void (*EpdCallback)(void* user_data, u16 thread_index, u64 line_offset,
+                            const GameState* state, const char* operations, size_t operations_length);
+
+typedef struct {
+    u64 nb_lines;      // Not counting empty lines and comments
+    u64 nb_positions;  // Valid ones, the ones given to the callback
+    u64 nb_invalid;
+    u64 nb_bytes;
+} EpdStats;
+
+// Maps the file and reads it on `nb_threads` threads (0 for one per core).
+// Lines starting with '#' are comments. Returns false if the file can't be
+// read, invalid lines are just counted.
+bool read_epd_file(const char* path, u16 nb_threads, EpdCallback callback, void* user_data, EpdStats* stats);
@@ -0,0 +1,283 @@
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "eval.h"
+
+const i16 piece_values[6] = {
+    [PAWN] = 100, [ROOK] = 500, [KNIGHT] = 320, [BISHOP] = 330, [QWEEN] = 900, [KING] = 0,
+};
+
+// Tables are seen from white, with rank 8 first like `ChessBoard`. Black pieces
+// read them with the rows flipped (`square ^ 56`).
+static const i8 pawn_table[64] = {
+     0,  0,  0,  0,  0,  0,  0,  0,
+    50, 50, 50, 50, 50, 50, 50, 50,
+    10, 10, 20, 30, 30, 20, 10, 10,
+     5,  5, 10, 25, 25, 10,  5,  5,
+     0,  0,  0, 20, 20,  0,  0,  0,
+     5, -5,-10,  0,  0,-10, -5,  5,
+     5, 10, 10,-20,-20, 10, 10,  5,
+     0,  0,  0,  0,  0,  0,  0,  0,
+};
+
+static const i8 rook_table[64] = {
+     0,  0,  0,  0,  0,  0,  0,  0,
+     5, 10, 10, 10, 10, 10, 10,  5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+    -5,  0,  0,  0,  0,  0,  0, -5,
+     0,  0,  0,  5,  5,  0,  0,  0,
+};
+
+static const i8 knight_table[64] = {
+    -50,-40,-30,-30,-30,-30,-40,-50,
+    -40,-20,  0,  0,  0,  0,-20,-40,
+    -30,  0, 10, 15, 15, 10,  0,-30,
+    -30,  5, 15, 20, 20, 15,  5,-30,
+    -30,  0, 15, 20, 20, 15,  0,-30,
+    -30,  5, 10, 15, 15, 10,  5,-30,
+    -40,-20,  0,  5,  5,  0,-20,-40,
+    -50,-40,-30,-30,-30,-30,-40,-50,
+};
+
+static const i8 bishop_table[64] = {
+    -20,-10,-10,-10,-10,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5, 10, 10,  5,  0,-10,
+    -10,  5,  5, 10, 10,  5,  5,-10,
+    -10,  0, 10, 10, 10, 10,  0,-10,
+    -10, 10, 10, 10, 10, 10, 10,-10,
+    -10,  5,  0,  0,  0,  0,  5,-10,
+    -20,-10,-10,-10,-10,-10,-10,-20,
+};
+
+static const i8 qween_table[64] = {
+    -20,-10,-10, -5, -5,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5,  5,  5,  5,  0,-10,
+     -5,  0,  5,  5,  5,  5,  0, -5,
+      0,  0,  5,  5,  5,  5,  0, -5,
+    -10,  5,  5,  5,  5,  5,  0,-10,
+    -10,  0,  5,  0,  0,  0,  0,-10,
+    -20,-10,-10, -5, -5,-10,-10,-20,
+};
+
+// The king hides while there are pieces to attack it, and comes to the center
+// once they are gone.
+static const i8 king_middle_game_table[64] = {
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -20,-30,-30,-40,-40,-30,-30,-20,
+    -10,-20,-20,-20,-20,-20,-20,-10,
+     20, 20,  0,  0,  0,  0, 20, 20,
+     20, 30, 10,  0,  0, 10, 30, 20,
+};
+
+static const i8 king_end_game_table[64] = {
+    -50,-40,-30,-20,-20,-30,-40,-50,
+    -30,-20,-10,  0,  0,-10,-20,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-30,  0,  0,  0,  0,-30,-30,
+    -50,-30,-30,-30,-30,-30,-30,-50,
+};
+
+static const i8* const piece_tables[5] = {
+    [PAWN] = pawn_table, [ROOK] = rook_table, [KNIGHT] = knight_table,
+    [BISHOP] = bishop_table, [QWEEN] = qween_table,
+};
+
+// How much of the middle game is left, from the pieces other than pawns
+static const u8 phase_weights[6] = { [ROOK] = 2, [KNIGHT] = 1, [BISHOP] = 1, [QWEEN] = 4 };
+#define MAX_PHASE 24
+
+i32 evaluate(const GameState* state) {
+    if (state->nnue.network != NULL) return nnue_evaluate(&state->nnue, state->color_to_play);
+
+    const Bitboards* bitboards = &state->bitboards;
+    i32 score = 0;  // For white
+    i32 phase = 0;
+
+    for (PieceColor color = WHITE; color <= BLACK; color++) {
+        const i32 sign = color == WHITE ? 1 : -1;
+        const u8 flip = color == WHITE ? 0 : 56;
+
+        for (PiecesType type = PAWN; type < KING; type++) {
+            Bitboard pieces = bitboards->pieces[color][type];
+            phase += phase_weights[type] * popcount(pieces);
+            while (pieces) {
+                const Square square = pop_lsb(&pieces) ^ flip;
+                score += sign * (piece_values[type] + piece_tables[type][square]);
+            }
+        }
+    }
+
+    if (phase > MAX_PHASE) phase = MAX_PHASE;
+    const Square white_king = lsb(bitboards->pieces[WHITE][KING]);
+    const Square black_king = lsb(bitboards->pieces[BLACK][KING]) ^ 56;
+    const i32 king_middle_game = king_middle_game_table[white_king] - king_middle_game_table[black_king];
+    const i32 king_end_game = king_end_game_table[white_king] - king_end_game_table[black_king];
+    score += (king_middle_game * phase + king_end_game * (MAX_PHASE - phase)) / MAX_PHASE;
+
+    return state->color_to_play == WHITE ? score : -score;
+}
+
+// Batch tables, one entry per square and piece code, black already negated
+// and flipped. Material and piece-square scores are split in low and high
+// bytes for byte shuffles, the king ones fit in a byte as they are.
+static u8 batch_low_bytes[64][16];
+static u8 batch_high_bytes[64][16];
+static i8 batch_king_middle_game[64][16];
+static i8 batch_king_end_game[64][16];
+static u8 batch_phases[16];
+
+__attribute__((constructor))
+static void init_batch_tables(void) {
+    for (Square square = 0; square < 64; square++) {
+        for (PieceColor color = WHITE; color <= BLACK; color++) {
+            const i32 sign = color == WHITE ? 1 : -1;
+            const Square table_square = color == WHITE ? square : square ^ 56;
+
+            for (PiecesType type = PAWN; type < KING; type++) {
+                const i16 score = sign * (piece_values[type] + piece_tables[type][table_square]);
+                batch_low_bytes[square][color << 3 | type] = score & 0xFF;
+                batch_high_bytes[square][color << 3 | type] = (u16) score >> 8;
+                batch_phases[color << 3 | type] = phase_weights[type];
+            }
+
+            batch_king_middle_game[square][color << 3 | KING] = sign * king_middle_game_table[table_square];
+            batch_king_end_game[square][color << 3 | KING] = sign * king_end_game_table[table_square];
+        }
+    }
+}
+
+static inline i32 finish_batch_score(i32 score, i32 phase, i32 king_middle_game, i32 king_end_game, u8 color_to_play) {
+    if (phase > MAX_PHASE) phase = MAX_PHASE;
+    score += (king_middle_game * phase + king_end_game * (MAX_PHASE - phase)) / MAX_PHASE;
+    return color_to_play == WHITE ? score : -score;
+}
+
+// Positions go by blocks, so that each square plane is read a cache line at a time
+#define BATCH_BLOCK 64
+
+static void evaluate_batch_scalar(const u8* squares, const u8* colors_to_play, size_t nb_positions, size_t start, i32* output) {
+    for (size_t block = start; block < nb_positions; block += BATCH_BLOCK) {
+        const size_t block_size = nb_positions - block < BATCH_BLOCK ? nb_positions - block : BATCH_BLOCK;
+        i32 scores[BATCH_BLOCK] = {0}, phases[BATCH_BLOCK] = {0};
+        i32 king_middle_games[BATCH_BLOCK] = {0}, king_end_games[BATCH_BLOCK] = {0};
+
+        for (Square square = 0; square < 64; square++) {
+            const u8* codes = &squares[square * nb_positions + block];
+            for (size_t i = 0; i < block_size; i++) {
+                const u8 code = codes[i] & 15;
+                scores[i] += (i16) (batch_low_bytes[square][code] | batch_high_bytes[square][code] << 8);
+                phases[i] += batch_phases[code];
+                king_middle_games[i] += batch_king_middle_game[square][code];
+                king_end_games[i] += batch_king_end_game[square][code];
+            }
+        }
+
+        for (size_t i = 0; i < block_size; i++) {
+            output[block + i] = finish_batch_score(scores[i], phases[i], king_middle_games[i], king_end_games[i],
+                colors_to_play[block + i]);
+        }
+    }
+}
+
+#ifdef __AVX2__
+typedef struct {
+    __m256i scores_low;   // i16, positions 0-7 and 16-23
+    __m256i scores_high;  // i16, positions 8-15 and 24-31
+    __m256i phases;
+    __m256i king_middle_games;
+    __m256i king_end_games;
+} BatchLanes;
+
+// Each byte lane is a position. The tables are looked up with byte shuffles,
+// one 16 byte table per square.
+static inline void add_square(BatchLanes* lanes, __m256i codes, __m256i low_table, __m256i high_table,
+        __m256i phases_table, __m256i middle_game_table, __m256i end_game_table) {
+    const __m256i low_bytes = _mm256_shuffle_epi8(low_table, codes);
+    const __m256i high_bytes = _mm256_shuffle_epi8(high_table, codes);
+    lanes->scores_low = _mm256_add_epi16(lanes->scores_low, _mm256_unpacklo_epi8(low_bytes, high_bytes));
+    lanes->scores_high = _mm256_add_epi16(lanes->scores_high, _mm256_unpackhi_epi8(low_bytes, high_bytes));
+
+    // At most 2 kings and 32 pieces, the sums fit in bytes
+    lanes->phases = _mm256_add_epi8(lanes->phases, _mm256_shuffle_epi8(phases_table, codes));
+    lanes->king_middle_games = _mm256_add_epi8(lanes->king_middle_games, _mm256_shuffle_epi8(middle_game_table, codes));
+    lanes->king_end_games = _mm256_add_epi8(lanes->king_end_games, _mm256_shuffle_epi8(end_game_table, codes));
+}
+
+static void finish_lanes(const BatchLanes* lanes, const u8* colors_to_play, i32* output) {
+    i16 scores[32];
+    u8 phases[32];
+    i8 king_middle_games[32], king_end_games[32];
+    _mm256_storeu_si256((__m256i*) scores, _mm256_permute2x128_si256(lanes->scores_low, lanes->scores_high, 0x20));
+    _mm256_storeu_si256((__m256i*) &scores[16], _mm256_permute2x128_si256(lanes->scores_low, lanes->scores_high, 0x31));
+    _mm256_storeu_si256((__m256i*) phases, lanes->phases);
+    _mm256_storeu_si256((__m256i*) king_middle_games, lanes->king_middle_games);
+    _mm256_storeu_si256((__m256i*) king_end_games, lanes->king_end_games);
+
+    for (size_t i = 0; i < 32; i++)
+        output[i] = finish_batch_score(scores[i], phases[i], king_middle_games[i], king_end_games[i], colors_to_play[i]);
+}
+
+static inline __m256i load_table(const void* table) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) table));
+}
+
+// Returns how many positions are done, the rest is left to the scalar code
+static size_t evaluate_batch_avx2(const u8* squares, const u8* colors_to_play, size_t nb_positions, i32* output) {
+    const __m256i phases_table = load_table(batch_phases);
+    const __m256i code_mask = _mm256_set1_epi8(15);
+    size_t block = 0;
+
+    for (; block + BATCH_BLOCK <= nb_positions; block += BATCH_BLOCK) {
+        BatchLanes lanes[2] = {0};
+
+        for (Square square = 0; square < 64; square++) {
+            // 64 planes at once are more streams than the hardware prefetcher follows
+            const u8* codes = &squares[square * nb_positions + block];
+            _mm_prefetch((const char*) codes + 8 * BATCH_BLOCK, _MM_HINT_T0);
+
+            const __m256i low_table = load_table(batch_low_bytes[square]);
+            const __m256i high_table = load_table(batch_high_bytes[square]);
+            const __m256i middle_game_table = load_table(batch_king_middle_game[square]);
+            const __m256i end_game_table = load_table(batch_king_end_game[square]);
+
+            for (size_t half = 0; half < 2; half++) {
+                const __m256i half_codes = _mm256_and_si256(code_mask, _mm256_loadu_si256((const __m256i*) &codes[half * 32]));
+                add_square(&lanes[half], half_codes, low_table, high_table, phases_table, middle_game_table, end_game_table);
+            }
+        }
+
+        finish_lanes(&lanes[0], &colors_to_play[block], &output[block]);
+        finish_lanes(&lanes[1], &colors_to_play[block + 32], &output[block + 32]);
+    }
+
+    return block;
+}
+#endif
+
+void evaluate_batch(const u8* squares, const u8* colors_to_play, size_t nb_positions, i32* output) {
+    size_t start = 0;
+#ifdef __AVX2__
+    start = evaluate_batch_avx2(squares, colors_to_play, nb_positions, output);
+#endif
+    evaluate_batch_scalar(squares, colors_to_play, nb_positions, start, output);
+}
+
+void set_batch_position(const GameState* state, u8* squares, u8* colors_to_play, size_t nb_positions, size_t index) {
+    for (Square square = 0; square < 64; square++) {
+        const Cell piece = state->board[square >> 3][square & 7];
+        squares[square * nb_positions + index] = piece.is_empty ? EMPTY_CODE : piece.color << 3 | piece.type;
+    }
+    colors_to_play[index] = state->color_to_play;
+}
@@ -0,0 +1,26 @@
+// vim:ft=c
+#pragma once
+
+#include "lib.h"
+
+// Centipawns, the king has none since it can't be traded
+extern const i16 piece_values[6];
+
+// Material and piece-square tables, from the side to play's point of view.
+// The attached NNUE network takes over when there is one.
+i32 evaluate(const GameState* state);
+
+// Batches for labelling datasets, in structure of arrays layout: one plane of
+// piece codes per square, `squares[square * nb_positions + i]` being the piece
+// on `square` in position `i`. Codes are `color << 3 | type` like in
+// `PackedPosition`, and `EMPTY_CODE` for empty squares. A NumPy array of
+// shape (64, n) and dtype uint8 can be handed over as is.
+#define EMPTY_CODE 15
+
+// `output[i]` gets the material and piece-square score of position `i`, the
+// one `evaluate` gives without a network. With AVX2, 64 positions are
+// evaluated at once.
+void evaluate_batch(const u8* squares, const u8* colors_to_play, size_t nb_positions, i32* output);
+
+// Writes the planes of position `index`, to build batches from states
+void set_batch_position(const GameState* state, u8* squares, u8* colors_to_play, size_t nb_positions, size_t index);
@@ -0,0 +1,316 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fen.h"
+
+bool parse_square(const char* str, Position* output) {
+    if (str[0] < 'a' || str[0] > 'h') return false;
+    if (str[1] < '1' || str[1] > '8') return false;
+    *output = (Position) { .col = str[0] - 'a', .row = '8' - str[1] };
+    return true;
+}
+
+void format_square(Position pos, char* output) {
+    output[0] = 'a' + pos.col;
+    output[1] = '8' - pos.row;
+    output[2] = '\0';
+}
+
+void format_uci_move(Move move, char* output) {
+    static const char promotion_letters[6] = { [ROOK] = 'r', [KNIGHT] = 'n', [BISHOP] = 'b', [QWEEN] = 'q' };
+    format_square(position_of(move.start), output);
+    format_square(position_of(move.end), output + 2);
+    output[4] = move.flags & MOVE_PROMOTION ? promotion_letters[move.promotion] : '\0';
+    output[5] = '\0';
+}
+
+// Only legal moves are accepted
+bool parse_uci_move(const GameState* state, const char* str, Move* output) {
+    Move moves[MAX_MOVES];
+    const size_t nb_moves = generate_legal_moves(state, moves);
+    for (size_t i = 0; i < nb_moves; i++) {
+        char formatted[UCI_MOVE_LENGTH];
+        format_uci_move(moves[i], formatted);
+        if (!strcmp(formatted, str)) {
+            *output = moves[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_piece(char c, Cell* output) {
+    const PieceColor color = isupper(c) ? WHITE : BLACK;
+    switch (tolower(c)) {
+        case 'p': *output = (Cell) { color, PAWN };   return true;
+        case 'r': *output = (Cell) { color, ROOK };   return true;
+        case 'n': *output = (Cell) { color, KNIGHT }; return true;
+        case 'b': *output = (Cell) { color, BISHOP }; return true;
+        case 'q': *output = (Cell) { color, QWEEN };  return true;
+        case 'k': *output = (Cell) { color, KING };   return true;
+        default: return false;
+    }
+}
+
+static char format_piece(Cell piece) {
+    static const char piece_chars[] = { [PAWN] = 'p', [ROOK] = 'r', [KNIGHT] = 'n', [BISHOP] = 'b', [QWEEN] = 'q', [KING] = 'k' };
+    const char c = piece_chars[piece.type];
+    return piece.color == WHITE ? toupper(c) : c;
+}
+
+static const char* skip_spaces(const char* str) {
+    while (*str == ' ') str++;
+    return str;
+}
+
+static const char* parse_counter(const char* str, u16* output) {
+    if (!isdigit(*str)) return NULL;
+    u32 value = 0;
+    while (isdigit(*str) && value <= UINT16_MAX) value = value * 10 + (*str++ - '0');
+    if (value > UINT16_MAX) return NULL;
+    *output = value;
+    return str;
+}
+
+// Things a FEN can describe but that can't happen in a game
+static bool is_valid_setup(const Bitboards* bitboards, PieceColor color_to_play, u8 castling_rights, const LastMove* last_move) {
+    const Bitboard back_ranks = ROW_BB(0) | ROW_BB(7);
+
+    for (PieceColor color = WHITE; color <= BLACK; color++) {
+        if (popcount(bitboards->pieces[color][KING]) != 1) return false;
+        if (popcount(bitboards->colors[color]) > 16) return false;
+        if (popcount(bitboards->pieces[color][PAWN]) > 8) return false;
+        if (bitboards->pieces[color][PAWN] & back_ranks) return false;
+    }
+
+    // The side that just played can't have left its king in check
+    const PieceColor waiting_color = color_to_play == WHITE ? BLACK : WHITE;
+    if (is_square_attacked(bitboards, lsb(bitboards->pieces[waiting_color][KING]), color_to_play)) return false;
+
+    // Castling needs the king and the rook on their starting cells
+    static const struct { CastlingRights right; Square king, rook; PieceColor color; } castles[] = {
+        { WHITE_SHORT_CASTLE, 60, 63, WHITE }, { WHITE_LONG_CASTLE, 60, 56, WHITE },
+        { BLACK_SHORT_CASTLE,  4,  7, BLACK }, { BLACK_LONG_CASTLE,  4,  0, BLACK },
+    };
+    for (size_t i = 0; i < 4; i++) {
+        if (!(castling_rights & castles[i].right)) continue;
+        if (!(bitboards->pieces[castles[i].color][KING] & square_bb(castles[i].king))) return false;
+        if (!(bitboards->pieces[castles[i].color][ROOK] & square_bb(castles[i].rook))) return false;
+    }
+
+    // The pawn that gave the en passant target has to be there, with the two
+    // cells it went through empty
+    if (last_move->moved_piece.type == PAWN && abs(last_move->end_position.row - last_move->start_position.row) == 2) {
+        const Position end = last_move->end_position;
+        const Position start = last_move->start_position;
+        const Position middle = { .col = end.col, .row = (start.row + end.row) / 2 };
+        if (!(bitboards->pieces[waiting_color][PAWN] & square_bb(square_of(end)))) return false;
+        if (bitboards->occupied & (square_bb(square_of(start)) | square_bb(square_of(middle)))) return false;
+    }
+
+    return true;
+}
+
+// The part of a GameState described by a FEN. Parsing into a GameState
+// directly would mean clearing its whole undo stack for every position.
+typedef struct {
+    ChessBoard board;
+    Bitboards bitboards;
+    PieceColor color_to_play;
+    u8 castling_rights;
+    LastMove last_move;
+    u16 halfmove_clock;
+    u16 fullmove_number;
+} FenFields;
+
+// Returns what follows the FEN fields, or NULL if they are invalid or describe
+// a position that can't be reached. Move counters are optional, EPD lines
+// don't have them.
+static const char* parse_fen_fields(const char* fen, FenFields* output) {
+    FenFields new_state = { .fullmove_number = 1 };
+
+    // Board
+    i8 row = 0, col = 0;
+    for (; *fen && *fen != ' '; fen++) {
+        if (*fen == '/') {
+            if (col != 8 || ++row >= 8) return NULL;
+            col = 0;
+        } else if (*fen >= '1' && *fen <= '8') {
+            for (i8 i = 0; i < *fen - '0'; i++) {
+                if (col >= 8) return NULL;
+                new_state.board[row][col++] = EMPTY_CELL;
+            }
+        } else {
+            Cell piece;
+            if (col >= 8 || !parse_piece(*fen, &piece)) return NULL;
+            new_state.board[row][col++] = piece;
+        }
+    }
+    if (row != 7 || col != 8) return NULL;
+    bitboards_from_chess_board(new_state.board, &new_state.bitboards);
+
+    // Side to move
+    fen = skip_spaces(fen);
+    switch (*fen++) {
+        case 'w': new_state.color_to_play = WHITE; break;
+        case 'b': new_state.color_to_play = BLACK; break;
+        default: return NULL;
+    }
+
+    // Castling rights
+    fen = skip_spaces(fen);
+    if (*fen == '-') {
+        fen++;
+    } else {
+        for (; *fen && *fen != ' '; fen++) {
+            switch (*fen) {
+                case 'K': new_state.castling_rights |= WHITE_SHORT_CASTLE; break;
+                case 'Q': new_state.castling_rights |= WHITE_LONG_CASTLE; break;
+                case 'k': new_state.castling_rights |= BLACK_SHORT_CASTLE; break;
+                case 'q': new_state.castling_rights |= BLACK_LONG_CASTLE; break;
+                default: return NULL;
+            }
+        }
+    }
+
+    // En passant target, we only keep the pawn move that created it
+    fen = skip_spaces(fen);
+    if (*fen == '-') {
+        fen++;
+    } else {
+        Position target;
+        if (!parse_square(fen, &target)) return NULL;
+        fen += 2;
+
+        const PieceColor pawn_color = new_state.color_to_play == WHITE ? BLACK : WHITE;
+        const i8 direction = pawn_color == WHITE ? -1 : 1;
+        if (target.row != (pawn_color == WHITE ? 5 : 2)) return NULL;
+
+        new_state.last_move = (LastMove) {
+            .moved_piece = { pawn_color, PAWN },
+            .start_position = { .col = target.col, .row = target.row - direction },
+            .end_position = { .col = target.col, .row = target.row + direction },
+        };
+    }
+
+    fen = skip_spaces(fen);
+    if (isdigit(*fen)) {
+        if (!(fen = parse_counter(fen, &new_state.halfmove_clock))) return NULL;
+        fen = skip_spaces(fen);
+        if (!(fen = parse_counter(fen, &new_state.fullmove_number))) return NULL;
+        fen = skip_spaces(fen);
+    }
+
+    if (!is_valid_setup(&new_state.bitboards, new_state.color_to_play, new_state.castling_rights, &new_state.last_move)) return NULL;
+
+    *output = new_state;
+    return fen;
+}
+
+static void set_fen_fields(GameState* state, const FenFields* new_state) {
+    memcpy(state->board, new_state->board, sizeof(ChessBoard));
+    state->bitboards = new_state->bitboards;
+    attack_maps_from_bitboards(&state->bitboards, &state->attacks);
+    state->dirty_squares = ~0ull;
+    state->color_to_play = new_state->color_to_play;
+    state->king_status = NO_CHECKS;
+    state->castling_rights = new_state->castling_rights;
+    state->last_move = new_state->last_move;
+    state->halfmove_clock = new_state->halfmove_clock;
+    state->fullmove_number = new_state->fullmove_number;
+    state->hash = compute_hash(state);
+    state->undo_top = 0;
+    state->nb_undo_records = 0;
+    state->nnue.network = NULL;  // To be attached again, states may come uninitialized
+}
+
+// Leaves `state` untouched if the FEN is invalid, or its position unreachable
+bool load_fen(GameState* state, const char* fen) {
+    FenFields fields;
+    fen = parse_fen_fields(fen, &fields);
+    if (fen == NULL || *fen) return false;
+
+    set_fen_fields(state, &fields);
+    return true;
+}
+
+// Anything after the position is EPD operations (`bm e4; id "..."`), they are
+// left to the caller.
+bool load_epd(GameState* state, const char* epd, const char** operations) {
+    FenFields fields;
+    epd = parse_fen_fields(epd, &fields);
+    if (epd == NULL) return false;
+
+    set_fen_fields(state, &fields);
+    if (operations != NULL) *operations = epd;
+    return true;
+}
+
+GameState* game_state_from_fen(const char* fen) {
+    GameState* state = game_state_create();
+    if (state == NULL) return NULL;
+
+    if (!load_fen(state, fen)) {
+        game_state_destroy(state);
+        return NULL;
+    }
+
+    return state;
+}
+
+size_t write_fen(const GameState* state, char* output) {
+    char* out = output;
+
+    // Board
+    for (i8 row = 0; row < 8; row++) {
+        u8 nb_empty = 0;
+        for (i8 col = 0; col < 8; col++) {
+            const Cell piece = state->board[row][col];
+            if (piece.is_empty) {
+                nb_empty++;
+                continue;
+            }
+            if (nb_empty) *out++ = '0' + nb_empty;
+            nb_empty = 0;
+            *out++ = format_piece(piece);
+        }
+        if (nb_empty) *out++ = '0' + nb_empty;
+        if (row < 7) *out++ = '/';
+    }
+
+    // Side to move
+    *out++ = ' ';
+    *out++ = state->color_to_play == WHITE ? 'w' : 'b';
+
+    // Castling rights
+    *out++ = ' ';
+    if (!state->castling_rights) *out++ = '-';
+    if (state->castling_rights & WHITE_SHORT_CASTLE) *out++ = 'K';
+    if (state->castling_rights & WHITE_LONG_CASTLE) *out++ = 'Q';
+    if (state->castling_rights & BLACK_SHORT_CASTLE) *out++ = 'k';
+    if (state->castling_rights & BLACK_LONG_CASTLE) *out++ = 'q';
+
+    // En passant target, right behind a pawn that just moved two cells
+    *out++ = ' ';
+    const LastMove* last_move = &state->last_move;
+    if (last_move->moved_piece.type == PAWN && last_move->moved_piece.color != state->color_to_play
+            && abs(last_move->end_position.row - last_move->start_position.row) == 2) {
+        const Position target = {
+            .col = last_move->end_position.col,
+            .row = (last_move->start_position.row + last_move->end_position.row) / 2,
+        };
+        format_square(target, out);
+        out += 2;
+    } else {
+        *out++ = '-';
+    }
+
+    out += sprintf(out, " %u %u", state->halfmove_clock, state->fullmove_number);
+    return out - output;
+}
+
+bool is_valid_position(const GameState* state) {
+    return is_valid_setup(&state->bitboards, state->color_to_play, state->castling_rights, &state->last_move);
+}
@@ -0,0 +1,30 @@
+// vim:ft=c
+#pragma once
+
+#include "lib.h"
+
+#define STARTING_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// Longest possible FEN, with its final NUL
+#define MAX_FEN_LENGTH 100
+
+// Longest move in UCI notation ("e7e8q"), with its final NUL
+#define UCI_MOVE_LENGTH 6
+
+// Squares use the usual algebraic notation ("e4"), not our (col, row) layout.
+bool parse_square(const char* str, Position* output);
+void format_square(Position pos, char* output);
+
+// Moves as UCI writes them, start and end squares then the promotion ("e7e8q").
+// `output` needs room for UCI_MOVE_LENGTH chars.
+void format_uci_move(Move move, char* output);
+bool parse_uci_move(const GameState* state, const char* str, Move* output);
+
+bool load_fen(GameState* state, const char* fen);
+bool load_epd(GameState* state, const char* epd, const char** operations);
+GameState* game_state_from_fen(const char* fen);
+
+// `output` needs room for MAX_FEN_LENGTH chars. Returns the FEN's length.
+size_t write_fen(const GameState* state, char* output);
+
+bool is_valid_position(const GameState* state);
@@ -0,0 +1,260 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "game_db.h"
+
+#define GAME_DB_MAGIC 0x3142444753534843ull  // "CHSSGDB1"
+
+typedef struct {
+    u64 magic;
+    u64 reserved;
+} GameDbHeader;
+
+struct GameDbWriter {
+    FILE* data_file;
+    char* index_path;
+    u64 offset;  // Where the next record goes
+    bool failed;  // A record was half written and couldn't be removed
+
+    // Positions of the games appended since the writer was opened
+    GameDbEntry* entries;
+    size_t nb_entries;
+    size_t entries_capacity;
+
+    GameState state;  // To replay the games being appended
+};
+
+static char* index_path_of(const char* path) {
+    char* index_path = malloc(strlen(path) + sizeof(".idx"));
+    if (index_path != NULL) sprintf(index_path, "%s.idx", path);
+    return index_path;
+}
+
+static int compare_entries(const void* a, const void* b) {
+    const GameDbEntry* entry_a = a;
+    const GameDbEntry* entry_b = b;
+    if (entry_a->hash != entry_b->hash) return entry_a->hash < entry_b->hash ? -1 : 1;
+    if (entry_a->location != entry_b->location) return entry_a->location < entry_b->location ? -1 : 1;
+    return 0;
+}
+
+GameDbWriter* game_db_open_writer(const char* path) {
+    GameDbWriter* writer = calloc(1, sizeof(GameDbWriter));
+    if (writer == NULL) return NULL;
+
+    writer->index_path = index_path_of(path);
+    writer->data_file = fopen(path, "r+b");
+    if (writer->data_file == NULL) writer->data_file = fopen(path, "w+b");
+    if (writer->index_path == NULL || writer->data_file == NULL) goto error;
+
+    GameDbHeader header;
+    if (fread(&header, sizeof(header), 1, writer->data_file) == 1) {
+        if (header.magic != GAME_DB_MAGIC) goto error;
+    } else {
+        header = (GameDbHeader) { .magic = GAME_DB_MAGIC };
+        rewind(writer->data_file);
+        if (fwrite(&header, sizeof(header), 1, writer->data_file) != 1) goto error;
+    }
+
+    if (fseek(writer->data_file, 0, SEEK_END) < 0) goto error;
+    writer->offset = ftell(writer->data_file);
+    return writer;
+
+error:
+    if (writer->data_file) fclose(writer->data_file);
+    free(writer->index_path);
+    free(writer);
+    return NULL;
+}
+
+static bool push_entry(GameDbWriter* writer, u64 hash, u16 ply) {
+    if (writer->nb_entries == writer->entries_capacity) {
+        const size_t capacity = writer->entries_capacity ? writer->entries_capacity * 2 : 4096;
+        GameDbEntry* entries = realloc(writer->entries, capacity * sizeof(GameDbEntry));
+        if (entries == NULL) return false;
+        writer->entries = entries;
+        writer->entries_capacity = capacity;
+    }
+
+    writer->entries[writer->nb_entries++] = (GameDbEntry) { .hash = hash, .location = writer->offset << 16 | ply };
+    return true;
+}
+
+// Drops what a failed append left behind. If the data file can't be cut back,
+// the writer stops accepting games rather than index them at the wrong place.
+static void rollback_append(GameDbWriter* writer, size_t nb_entries, bool wrote_data) {
+    writer->nb_entries = nb_entries;
+    if (!wrote_data) return;
+
+    if (fflush(writer->data_file) != 0 || ftruncate(fileno(writer->data_file), writer->offset) < 0
+            || fseek(writer->data_file, writer->offset, SEEK_SET) < 0) {
+        writer->failed = true;
+    }
+}
+
+// The moves have to be legal, they are played without being checked
+bool game_db_append(GameDbWriter* writer, const GameState* start, const Move* moves, u16 nb_moves, GameResult result) {
+    if (writer->failed) return false;
+    const size_t nb_entries = writer->nb_entries;
+    bool wrote_data = false;
+
+    GameDbRecord record = { .nb_moves = nb_moves, .result = result };
+    pack_position(start, &record.start);
+
+    // Replays from the packed position, so that the index matches what a
+    // reader gets back
+    GameState* state = &writer->state;
+    if (!unpack_position(&record.start, state)) goto error;
+    if (!push_entry(writer, state->hash, 0)) goto error;
+    for (u16 i = 0; i < nb_moves; i++) {
+        make_move(state, moves[i]);
+        if (!push_entry(writer, state->hash, i + 1)) goto error;
+    }
+
+    wrote_data = true;
+    if (fwrite(&record, sizeof(record), 1, writer->data_file) != 1) goto error;
+    for (u16 i = 0; i < nb_moves; i++) {
+        const PackedMove move = pack_move(moves[i]);
+        if (fwrite(&move, sizeof(move), 1, writer->data_file) != 1) goto error;
+    }
+
+    const size_t moves_size = nb_moves * sizeof(PackedMove);
+    const size_t padding_size = (8 - moves_size % 8) % 8;
+    static const u8 padding[8] = {0};
+    if (padding_size && fwrite(padding, padding_size, 1, writer->data_file) != 1) goto error;
+
+    writer->offset += sizeof(record) + moves_size + padding_size;
+    return true;
+
+error:
+    rollback_append(writer, nb_entries, wrote_data);
+    return false;
+}
+
+// Merges the sorted new entries into the index, through a temporary file so
+// that readers never see half of it.
+static bool write_index(GameDbWriter* writer) {
+    qsort(writer->entries, writer->nb_entries, sizeof(GameDbEntry), compare_entries);
+
+    char* tmp_path = malloc(strlen(writer->index_path) + sizeof(".tmp"));
+    if (tmp_path == NULL) return false;
+    sprintf(tmp_path, "%s.tmp", writer->index_path);
+
+    FILE* old_index = fopen(writer->index_path, "rb");
+    FILE* new_index = fopen(tmp_path, "wb");
+    bool ok = new_index != NULL;
+
+    GameDbEntry old_entry;
+    bool has_old_entry = old_index && fread(&old_entry, sizeof(old_entry), 1, old_index) == 1;
+    size_t i = 0;
+    while (ok && (has_old_entry || i < writer->nb_entries)) {
+        if (has_old_entry && (i == writer->nb_entries || compare_entries(&old_entry, &writer->entries[i]) <= 0)) {
+            ok = fwrite(&old_entry, sizeof(old_entry), 1, new_index) == 1;
+            has_old_entry = fread(&old_entry, sizeof(old_entry), 1, old_index) == 1;
+        } else {
+            ok = fwrite(&writer->entries[i++], sizeof(GameDbEntry), 1, new_index) == 1;
+        }
+    }
+
+    if (old_index) fclose(old_index);
+    if (new_index && fclose(new_index) != 0) ok = false;
+    if (ok) ok = rename(tmp_path, writer->index_path) == 0;
+    else remove(tmp_path);
+
+    free(tmp_path);
+    return ok;
+}
+
+bool game_db_close_writer(GameDbWriter* writer) {
+    // The games have to be on disk before the index points at them
+    bool ok = fflush(writer->data_file) == 0 && fsync(fileno(writer->data_file)) == 0;
+    ok = fclose(writer->data_file) == 0 && ok;
+    if (ok && writer->nb_entries) ok = write_index(writer);
+    ok = ok && !writer->failed;  // The games before the broken one are still indexed
+
+    free(writer->entries);
+    free(writer->index_path);
+    free(writer);
+    return ok;
+}
+
+static const void* map_file(const char* path, size_t* size) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || file_stat.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    *size = file_stat.st_size;
+    const void* data = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return data == MAP_FAILED ? NULL : data;
+}
+
+GameDb* game_db_open(const char* path) {
+    GameDb* db = calloc(1, sizeof(GameDb));
+    char* index_path = index_path_of(path);
+    if (db == NULL || index_path == NULL) goto error;
+
+    db->data = map_file(path, &db->data_size);
+    if (db->data == NULL || db->data_size < sizeof(GameDbHeader)) goto error;
+    if (((const GameDbHeader*) db->data)->magic != GAME_DB_MAGIC) goto error;
+
+    // No index yet just means no games
+    size_t index_size = 0;
+    db->entries = map_file(index_path, &index_size);
+    db->nb_entries = index_size / sizeof(GameDbEntry);
+
+    free(index_path);
+    return db;
+
+error:
+    if (db) game_db_close(db);
+    free(index_path);
+    return NULL;
+}
+
+void game_db_close(GameDb* db) {
+    if (db == NULL) return;
+    if (db->data) munmap((void*) db->data, db->data_size);
+    if (db->entries) munmap((void*) db->entries, db->nb_entries * sizeof(GameDbEntry));
+    free(db);
+}
+
+const GameDbEntry* game_db_find(const GameDb* db, u64 hash, size_t* nb_matches) {
+    // First entry with that hash or a bigger one
+    size_t low = 0, high = db->nb_entries;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (db->entries[middle].hash < hash) low = middle + 1;
+        else high = middle;
+    }
+
+    size_t end = low;
+    while (end < db->nb_entries && db->entries[end].hash == hash) end++;
+    *nb_matches = end - low;
+    return end > low ? &db->entries[low] : NULL;
+}
+
+const GameDbRecord* game_db_record(const GameDb* db, u64 offset) {
+    if (offset < sizeof(GameDbHeader) || offset % 8 || offset + sizeof(GameDbRecord) > db->data_size) return NULL;
+    const GameDbRecord* record = (const GameDbRecord*) (db->data + offset);
+    if (offset + sizeof(GameDbRecord) + record->nb_moves * sizeof(PackedMove) > db->data_size) return NULL;
+    return record;
+}
+
+bool game_db_replay(const GameDbRecord* record, u16 ply, GameState* output) {
+    if (ply > record->nb_moves || !unpack_position(&record->start, output)) return false;
+
+    const PackedMove* moves = game_db_record_moves(record);
+    for (u16 i = 0; i < ply; i++) make_move(output, unpack_move(moves[i]));
+    return true;
+}
@@ -0,0 +1,55 @@
+// vim:ft=c
+#pragma once
+
+#include "lib.h"
+#include "packed.h"
+#include "pgn.h"
+
+// Two files: `path` holds the games one after the other and only ever grows,
+// `path.idx` holds one entry per position of every game, sorted by hash. Both
+// are mapped when reading, so queries never copy anything.
+
+// Each record is followed by its moves, padded to 8 bytes
+typedef struct {
+    PackedPosition start;
+    u16 nb_moves;
+    GameResult result;
+    u8 padding[5];
+} GameDbRecord;
+
+typedef struct {
+    u64 hash;
+    u64 location;  // Offset of the game's record << 16 | ply
+} GameDbEntry;
+
+static inline u64 game_db_entry_offset(const GameDbEntry* entry) { return entry->location >> 16; }
+static inline u16 game_db_entry_ply(const GameDbEntry* entry) { return entry->location & 0xFFFF; }
+
+static inline const PackedMove* game_db_record_moves(const GameDbRecord* record) {
+    return (const PackedMove*) (record + 1);
+}
+
+typedef struct GameDbWriter GameDbWriter;
+
+typedef struct {
+    const u8* data;
+    size_t data_size;
+    const GameDbEntry* entries;
+    size_t nb_entries;
+} GameDb;
+
+// Appending is done by one writer at a time. Its positions only make it to the
+// index on `game_db_close_writer`. A failed append leaves no trace of the game.
+GameDbWriter* game_db_open_writer(const char* path);
+bool game_db_append(GameDbWriter* writer, const GameState* start, const Move* moves, u16 nb_moves, GameResult result);
+bool game_db_close_writer(GameDbWriter* writer);
+
+GameDb* game_db_open(const char* path);
+void game_db_close(GameDb* db);
+
+// All the times a position was reached, or NULL if it never was
+const GameDbEntry* game_db_find(const GameDb* db, u64 hash, size_t* nb_matches);
+const GameDbRecord* game_db_record(const GameDb* db, u64 offset);
+
+// Puts `output` in the position the game reached after `ply` moves
+bool game_db_replay(const GameDbRecord* record, u16 ply, GameState* output);
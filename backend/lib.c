@@ -1,9 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#include "common_types.h"
+#include "lib.h"
+#include "profile.h"
+#include "zobrist.h"
 
-static ChessBoard main_chess_board = {
+static const ChessBoard starting_chess_board = {
     { {BLACK, ROOK}, {BLACK, KNIGHT}, {BLACK, BISHOP}, {BLACK, QWEEN}, {BLACK, KING}, {BLACK, BISHOP}, {BLACK, KNIGHT}, {BLACK, ROOK} },
     { {BLACK, PAWN}, {BLACK, PAWN}, {BLACK, PAWN}, {BLACK, PAWN}, {BLACK, PAWN}, {BLACK, PAWN}, {BLACK, PAWN}, {BLACK, PAWN} },
     { {.is_empty = true}, {.is_empty = true}, {.is_empty = true}, {.is_empty = true}, {.is_empty = true}, {.is_empty = true}, {.is_empty = true}, {.is_empty = true} },
@@ -14,23 +17,39 @@ static ChessBoard main_chess_board = {
     { {WHITE, ROOK}, {WHITE, KNIGHT}, {WHITE, BISHOP}, {WHITE, QWEEN}, {WHITE, KING}, {WHITE, BISHOP}, {WHITE, KNIGHT}, {WHITE, ROOK} },
 };
 
-static PieceColor color_to_play = WHITE;
+GameState* game_state_create(void) {
+    GameState* state = malloc(sizeof(GameState));
+    if (state == NULL) return NULL;
 
-static KingStatus king_status = NO_CHECKS;
+    *state = (GameState) {
+        .color_to_play = WHITE,
+        .king_status = NO_CHECKS,
+        .castling_rights = ALL_CASTLING_RIGHTS,
+        .fullmove_number = 1,
+    };
+    memcpy(state->board, starting_chess_board, sizeof(ChessBoard));
+    bitboards_from_chess_board(state->board, &state->bitboards);
+    attack_maps_from_bitboards(&state->bitboards, &state->attacks);
+    state->dirty_squares = ~0ull;
+    state->hash = compute_hash(state);
+    return state;
+}
 
-static bool white_short_can_castle = true;
-static bool black_short_can_castle = true;
-static bool white_long_can_castle = true;
-static bool black_long_can_castle = true;
+GameState* game_state_clone(const GameState* state) {
+    GameState* clone = malloc(sizeof(GameState));
+    if (clone == NULL) return NULL;
+    *clone = *state;
+    return clone;
+}
+
+void game_state_destroy(GameState* state) {
+    free(state);
+}
 
-static struct {
-    Cell moved_piece;
-    Position start_position;
-    Position end_position;
-} last_move;
+ChessBoard* get_chess_board(GameState* state) { return &state->board; }
+PieceColor get_color_to_play(const GameState* state) { return state->color_to_play; }
 
-ChessBoard* get_main_chess_board() { return &main_chess_board; }
-PieceColor get_color_to_play() { return color_to_play; }
+u64 get_hash(const GameState* state) { return state->hash; }
 
 static void log_position(Position pos) {
     printf("(col: %hhu, row: %hhu)\n", pos.col, pos.row);
@@ -43,20 +62,6 @@ static inline Position add_positions(Position pos_a, Position pos_b) {
     };
 }
 
-static inline Position add_positions3(Position pos_a, Position pos_b, Position pos_c) {
-    return (Position) {
-        .col = pos_a.col + pos_b.col + pos_c.col,
-        .row = pos_a.row + pos_b.row + pos_c.row,
-    };
-}
-
-static inline Position mul_position(Position pos, i8 multiplier) {
-    return (Position) {
-        .col = pos.col * multiplier,
-        .row = pos.row * multiplier,
-    };
-}
-
 static inline bool eq_cells(Cell cell_a, Cell cell_b) {
     if (cell_a.is_empty) return cell_b.is_empty;
     return cell_a.is_empty == cell_b.is_empty && cell_a.type == cell_b.type && cell_a.color == cell_b.color;
@@ -76,182 +81,159 @@ void set_piece_at(ChessBoard board, Position pos, Cell piece) {
     board[pos.row][pos.col] = piece;
 }
 
-static inline CellState get_cell_state(ChessBoard board, Position cell_pos, PieceColor piece_color) {
-    if (cell_pos.col >= 8 || cell_pos.row >= 8) return OUT_OF_BOUNDS;
-    if (cell_pos.col < 0  || cell_pos.row < 0)  return OUT_OF_BOUNDS;
-    const Cell other_piece = get_piece_at(board, cell_pos);
-    if (other_piece.is_empty) return FREE;
-    return other_piece.color == piece_color ? SAME_COLOR : OTHER_COLOR;
+static size_t push_targets(Bitboard targets, Position* output) {
+    size_t nb_moves = 0;
+    while (targets) output[nb_moves++] = position_of(pop_lsb(&targets));
+    return nb_moves;
 }
 
-static size_t get_moves_line(ChessBoard board, Position pos, Direction dir, PieceColor color, Position* output) {
-    // FIXME: This is fucking disgusting.
-    Position aimed_cell;
-    CellState aimed_cell_state;
-    i32 i = 0;
-
-    while ((aimed_cell_state = get_cell_state(board, aimed_cell = add_positions(pos, mul_position(dir, ++i)), color)) == FREE)
-        output[i - 1] = aimed_cell;
+static Bitboard pawn_push_targets(const Bitboards* bitboards, Square square, PieceColor piece_color) {
+    const Bitboard empty = ~bitboards->occupied;
+    const Bitboard start_row = ROW_BB(piece_color == WHITE ? 6 : 1);
+    const Bitboard pawn = square_bb(square);
 
-    if (aimed_cell_state == OTHER_COLOR) {
-        output[i - 1] = aimed_cell;
-        return i;
+    if (piece_color == WHITE) {
+        const Bitboard one_step = (pawn >> 8) & empty;
+        return one_step | (((pawn & start_row) >> 16) & empty & (one_step >> 8));
     }
 
-    return i - 1;
+    const Bitboard one_step = (pawn << 8) & empty;
+    return one_step | (((pawn & start_row) << 16) & empty & (one_step << 8));
 }
 
-static size_t get_move_if_valid(ChessBoard board, Position pos, Direction dir, PieceColor color, Position* output) {
-    Position aimed_cell = add_positions(pos, dir);
-    switch (get_cell_state(board, aimed_cell, color)) {
-        case FREE:
-        case OTHER_COLOR:
-            *output = aimed_cell;
-            return 1;
+// The cell an enemy pawn just jumped over, if `piece_color` can take it en passant
+static Bitboard en_passant_target(const GameState* state, PieceColor piece_color) {
+    const LastMove* last_move = &state->last_move;
+    if (last_move->moved_piece.type != PAWN || last_move->moved_piece.color == piece_color) return 0;
+    if (abs(last_move->end_position.row - last_move->start_position.row) != 2) return 0;
 
-        case SAME_COLOR:
-        case OUT_OF_BOUNDS:
-            return 0;
-    }
+    const Position target = {
+        .col = last_move->end_position.col,
+        .row = (last_move->start_position.row + last_move->end_position.row) / 2,
+    };
+    return square_bb(square_of(target));
 }
 
-static size_t get_pawn_moves_line(ChessBoard board, Position pos, Position* output, PieceColor piece_color) {
-    Direction pawn_direction = piece_color == WHITE ? DIR_N : DIR_S;
-    size_t nb_moves = 0;
-
-    Position aimed_cell = add_positions(pos, pawn_direction);
-    if (get_cell_state(board, aimed_cell, piece_color) != FREE) return 0;
-    output[nb_moves++] = aimed_cell;
+// Same position, same hash: the en passant column only counts when a pawn of
+// the side to play can take there. -1 otherwise.
+i8 get_en_passant_column(const GameState* state) {
+    const PieceColor color = state->color_to_play;
+    const Bitboard target = en_passant_target(state, color);
+    if (!target) return -1;
 
-    if (pos.row == 1 || pos.row == 6) {
-        aimed_cell = add_positions(aimed_cell, pawn_direction);
-        if (get_cell_state(board, aimed_cell, piece_color) == FREE) {
-            output[nb_moves++] = aimed_cell;
-        }
-    }
+    const Bitboard takers = pawn_attacks[get_opposite_color(color)][lsb(target)] & state->bitboards.pieces[color][PAWN];
+    return takers ? lsb(target) & 7 : -1;
+}
 
-    return nb_moves;
+// NULL detaches the network, the accumulator is then left as is
+void set_nnue_network(GameState* state, const NnueNetwork* network) {
+    state->nnue.network = network;
+    if (network == NULL) return;
+    nnue_refresh(&state->nnue, &state->bitboards, WHITE);
+    nnue_refresh(&state->nnue, &state->bitboards, BLACK);
 }
 
-static size_t get_pawn_diagonal_if_valid(ChessBoard board, Position pos, Position* output, PieceColor piece_color, Direction horizontal) {
-    Direction pawn_direction = piece_color == WHITE ? DIR_N : DIR_S;
-    Position aimed_cell = add_positions3(pos, pawn_direction, horizontal);
+Bitboard get_dirty_squares(const GameState* state) { return state->dirty_squares; }
 
-    if (get_cell_state(board, aimed_cell, piece_color) == OTHER_COLOR) {
-        *output = aimed_cell;
-        return 1;
+size_t get_board_changes(const GameState* state, SquareChange* output) {
+    Bitboard dirty = state->dirty_squares;
+    size_t nb_changes = 0;
+    while (dirty) {
+        const Square square = pop_lsb(&dirty);
+        output[nb_changes++] = (SquareChange) { position_of(square), state->board[square >> 3][square & 7] };
     }
+    return nb_changes;
+}
+
+static inline u64 en_passant_hash(const GameState* state) {
+    const i8 col = get_en_passant_column(state);
+    return col >= 0 ? zobrist_en_passant[col] : 0;
+}
 
-    // En passant
-    if (last_move.moved_piece.type != PAWN) return 0;
-    if (abs(last_move.end_position.row - last_move.start_position.row) != 2) return 0;
+u64 compute_hash(const GameState* state) {
+    u64 hash = zobrist_castling[state->castling_rights] ^ en_passant_hash(state);
+    if (state->color_to_play == BLACK) hash ^= zobrist_black_to_play;
 
-    if (eq_positions(last_move.end_position, add_positions(pos, horizontal))) {
-        *output = aimed_cell;
-        return 1;
+    Bitboard occupied = state->bitboards.occupied;
+    while (occupied) {
+        const Square square = pop_lsb(&occupied);
+        hash ^= zobrist_piece(state->board[square >> 3][square & 7], square);
     }
-    return 0;
+    return hash;
 }
 
-static size_t get_possible_moves_pawn(ChessBoard board, Position pos, Position* output, PieceColor piece_color) {
-    size_t nb_moves = get_pawn_moves_line(board, pos, output, piece_color);
-    nb_moves += get_pawn_diagonal_if_valid(board, pos, output + nb_moves, piece_color, DIR_W);
-    nb_moves += get_pawn_diagonal_if_valid(board, pos, output + nb_moves, piece_color, DIR_E);
-    return nb_moves;
+static size_t get_possible_moves_pawn(const GameState* state, Position pos, Position* output, PieceColor piece_color) {
+    const Bitboards* bitboards = &state->bitboards;
+    const Square square = square_of(pos);
+    const Bitboard capturable = bitboards->colors[get_opposite_color(piece_color)] | en_passant_target(state, piece_color);
+    const Bitboard targets = pawn_push_targets(bitboards, square, piece_color) | (pawn_attacks[piece_color][square] & capturable);
+    return push_targets(targets, output);
 }
 
-static size_t get_possible_moves_rook(ChessBoard board, Position pos, Position* output, PieceColor piece_color) {
-    size_t nb_moves = 0;
-    nb_moves += get_moves_line(board, pos, DIR_W, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_E, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_N, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_S, piece_color, output + nb_moves);
-    return nb_moves;
+static size_t get_possible_moves_rook(const GameState* state, Position pos, Position* output, PieceColor piece_color) {
+    const Bitboards* bitboards = &state->bitboards;
+    const Bitboard targets = rook_attacks(square_of(pos), bitboards->occupied);
+    return push_targets(targets & ~bitboards->colors[piece_color], output);
 }
 
-static size_t get_possible_moves_knight(ChessBoard board, Position pos, Position* output, PieceColor piece_color) {
-    size_t nb_moves = 0;
-    nb_moves += get_move_if_valid(board, pos, (Direction) { .row =  1, .col =  2 }, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, (Direction) { .row = -1, .col =  2 }, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, (Direction) { .row =  1, .col = -2 }, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, (Direction) { .row = -1, .col = -2 }, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, (Direction) { .row =  2, .col =  1 }, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, (Direction) { .row =  2, .col = -1 }, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, (Direction) { .row = -2, .col =  1 }, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, (Direction) { .row = -2, .col = -1 }, piece_color, output + nb_moves);
-
-    return nb_moves;
+static size_t get_possible_moves_knight(const GameState* state, Position pos, Position* output, PieceColor piece_color) {
+    const Bitboards* bitboards = &state->bitboards;
+    const Bitboard targets = knight_attacks[square_of(pos)];
+    return push_targets(targets & ~bitboards->colors[piece_color], output);
 }
 
-static size_t get_possible_moves_bishop(ChessBoard board, Position pos, Position* output, PieceColor piece_color) {
-    size_t nb_moves = 0;
-    nb_moves += get_moves_line(board, pos, DIR_SE, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_SW, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_NE, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_NW, piece_color, output + nb_moves);
-    return nb_moves;
+static size_t get_possible_moves_bishop(const GameState* state, Position pos, Position* output, PieceColor piece_color) {
+    const Bitboards* bitboards = &state->bitboards;
+    const Bitboard targets = bishop_attacks(square_of(pos), bitboards->occupied);
+    return push_targets(targets & ~bitboards->colors[piece_color], output);
 }
 
-static size_t get_possible_moves_qween(ChessBoard board, Position pos, Position* output, PieceColor piece_color) {
-    size_t nb_moves = 0;
-    nb_moves += get_moves_line(board, pos, DIR_W, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_E, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_N, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_S, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_SE, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_SW, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_NE, piece_color, output + nb_moves);
-    nb_moves += get_moves_line(board, pos, DIR_NW, piece_color, output + nb_moves);
-    return nb_moves;
+static size_t get_possible_moves_qween(const GameState* state, Position pos, Position* output, PieceColor piece_color) {
+    const Bitboards* bitboards = &state->bitboards;
+    const Bitboard targets = queen_attacks(square_of(pos), bitboards->occupied);
+    return push_targets(targets & ~bitboards->colors[piece_color], output);
 }
 
-static size_t get_possible_moves_king(ChessBoard board, Position pos, Position* output, PieceColor piece_color) {
-    size_t nb_moves = 0;
-    nb_moves += get_move_if_valid(board, pos, DIR_W, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, DIR_E, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, DIR_N, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, DIR_S, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, DIR_SE, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, DIR_SW, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, DIR_NE, piece_color, output + nb_moves);
-    nb_moves += get_move_if_valid(board, pos, DIR_NW, piece_color, output + nb_moves);
-
-    bool long_castle_available = true;
-    bool can_long_castle = piece_color == WHITE
-        ? white_long_can_castle
-        : black_long_can_castle;
-
-    for (size_t col = 1; col < pos.col; col++) {
-        const Position aimed_cell = { .col = col, .row = pos.row };
-        if (get_cell_state(board, aimed_cell, piece_color) != FREE) {
-            long_castle_available = false;
-            break;
-        }
-    }
+static Bitboard castling_targets(const GameState* state, Position pos, PieceColor piece_color) {
+    const Bitboards* bitboards = &state->bitboards;
 
-    if (long_castle_available && can_long_castle)
-        output[nb_moves++] = (Position) { .col = 1, .row = pos.row };
+    const bool can_long_castle = state->castling_rights & long_castle_right(piece_color);
+    const bool can_short_castle = state->castling_rights & short_castle_right(piece_color);
 
-    bool short_castle_available = true;
-    bool can_short_castle = piece_color == WHITE
-        ? white_short_can_castle
-        : black_short_can_castle;
+    // Castling rights are lost as soon as the king moves, so if any are left
+    // the king is still on its starting cell. It can neither castle out of,
+    // through, nor into check.
+    const Bitboard attacked = attacked_squares(&state->attacks, get_opposite_color(piece_color));
+    const Square king_square = square_of(pos);
+    if (!can_long_castle && !can_short_castle) return 0;
+    if (attacked & square_bb(king_square)) return 0;
 
-    for (size_t col = pos.col + 1; col < 7; col++) {
-        const Position aimed_cell = { .col = col, .row = pos.row };
-        if (get_cell_state(board, aimed_cell, piece_color) != FREE) {
-            short_castle_available = false;
-            break;
-        }
+    // Cells between the king and each corner of its row
+    const Bitboard long_castle_path = (((1ull << pos.col) - 1) & ~1ull) << (pos.row * 8);
+    const Bitboard short_castle_path = (0x7Full & ~((2ull << pos.col) - 1)) << (pos.row * 8);
+    Bitboard targets = 0;
+
+    if (can_long_castle && !(bitboards->occupied & long_castle_path) &&
+        !(attacked & (square_bb(king_square - 1) | square_bb(king_square - 2)))
+    ) {
+        targets |= square_bb(king_square - 2);
+    }
+
+    if (can_short_castle && !(bitboards->occupied & short_castle_path) &&
+        !(attacked & (square_bb(king_square + 1) | square_bb(king_square + 2)))
+    ) {
+        targets |= square_bb(king_square + 2);
     }
 
-    if (short_castle_available && can_short_castle)
-        output[nb_moves++] = (Position) { .col = 6, .row = pos.row };
+    return targets;
+}
 
-    return nb_moves;
+static size_t get_possible_moves_king(const GameState* state, Position pos, Position* output, PieceColor piece_color) {
+    const Bitboard targets = king_attacks[square_of(pos)] & ~state->bitboards.colors[piece_color];
+    return push_targets(targets | castling_targets(state, pos, piece_color), output);
 }
 
-typedef size_t (*MovesGetter)(ChessBoard, Position, Position*, PieceColor);
+typedef size_t (*MovesGetter)(const GameState*, Position, Position*, PieceColor);
 
 static MovesGetter get_moves_getter(PiecesType piece_type) {
     static const MovesGetter move_getters[] = {
@@ -266,54 +248,47 @@ static MovesGetter get_moves_getter(PiecesType piece_type) {
     return move_getters[piece_type];
 }
 
-size_t get_possible_moves(ChessBoard board, Position pos, Position* output) {
-    const Cell piece = get_piece_at(board, pos);
-    if (piece.is_empty) return 0;
-    return get_moves_getter(piece.type)(board, pos, output, piece.color);
-}
-
-
-static bool is_in_check_by(ChessBoard board, Position king_position, PieceColor king_color, PiecesType piece_type) {
-    const Cell template = { get_opposite_color(king_color), piece_type };
-    Position moves_buffer[24];
-    MovesGetter moves_getter = get_moves_getter(piece_type);
-    size_t nb_moves = moves_getter(board, king_position, moves_buffer, king_color);
-
-    for (size_t i = 0; i < nb_moves; i++) {
-        const Cell current_cell = get_piece_at(board, moves_buffer[i]);
-        if (eq_cells(template, current_cell)) {
-            return true;
-        }
+size_t get_possible_moves(const GameState* state, Position pos, Position* output) {
+    PROFILE_BEGIN(call);
+    const Cell piece = state->board[pos.row][pos.col];
+    size_t nb_moves = 0;
+    if (!piece.is_empty) {
+        PROFILE_BEGIN(getter);
+        nb_moves = get_moves_getter(piece.type)(state, pos, output, piece.color);
+        PROFILE_END(getter, PROFILE_GET_MOVES_PAWN + piece.type);
     }
-
-    return false;
+    PROFILE_END(call, PROFILE_GET_POSSIBLE_MOVES);
+    return nb_moves;
 }
 
-bool is_in_check(ChessBoard board, PieceColor king_color, Position king_position) {
-    if (is_in_check_by(board, king_position, king_color, PAWN)) return true;
-    if (is_in_check_by(board, king_position, king_color, ROOK)) return true;
-    if (is_in_check_by(board, king_position, king_color, KNIGHT)) return true;
-    if (is_in_check_by(board, king_position, king_color, BISHOP)) return true;
-    if (is_in_check_by(board, king_position, king_color, QWEEN)) return true;
-    if (is_in_check_by(board, king_position, king_color, KING)) return true;
-    return false;
+bool is_in_check(const GameState* state, PieceColor king_color, Position king_position) {
+    PROFILE_BEGIN(call);
+    const bool in_check = attacked_squares(&state->attacks, get_opposite_color(king_color)) & square_bb(square_of(king_position));
+    PROFILE_END(call, PROFILE_IS_IN_CHECK);
+    return in_check;
 }
 
-bool is_in_check_after_move(ChessBoard board, PieceColor king_color, Position king_position, Position start, Position end) {
-    const Cell original_piece_at_end = get_piece_at(board, end);
-    const Cell moved_piece = get_piece_at(board, start);
-    set_piece_at(board, end, moved_piece);
-    set_piece_at(board, start, EMPTY_CELL);
-
-    const bool check = is_in_check(board, king_color, king_position);
-
-    set_piece_at(board, start, moved_piece);
-    set_piece_at(board, end, original_piece_at_end);
+bool is_in_check_after_move(const GameState* state, PieceColor king_color, Position king_position, Position start, Position end) {
+    Bitboards after_move = state->bitboards;
+    const Square start_square = square_of(start);
+    const Square end_square = square_of(end);
+
+    const Cell original_piece_at_end = bitboards_piece_at(&after_move, end_square);
+    const Cell moved_piece = bitboards_piece_at(&after_move, start_square);
+    if (!original_piece_at_end.is_empty) bitboards_remove_piece(&after_move, end_square, original_piece_at_end);
+    bitboards_remove_piece(&after_move, start_square, moved_piece);
+    bitboards_put_piece(&after_move, end_square, moved_piece);
+
+    // En passant: the captured pawn isn't on the end cell
+    if (moved_piece.type == PAWN && start.col != end.col && original_piece_at_end.is_empty) {
+        const Cell captured_pawn = { get_opposite_color(moved_piece.color), PAWN };
+        bitboards_remove_piece(&after_move, square_of((Position) { .col = end.col, .row = start.row }), captured_pawn);
+    }
 
-    return check;
+    return is_square_attacked(&after_move, square_of(king_position), get_opposite_color(king_color));
 }
 
-Position find_cell(ChessBoard board, Cell cell) {
+static Position find_cell_unprofiled(ChessBoard board, Cell cell) {
     for (size_t row = 0; row < 8; row++) {
         for (size_t col = 0; col < 8; col++) {
             const Position piece_position = { col, row };
@@ -326,114 +301,410 @@ Position find_cell(ChessBoard board, Cell cell) {
     exit(1);
 }
 
-static bool has_moves_available(ChessBoard board, PieceColor color) {
-    const Position base_king_pos = find_cell(board, (Cell) { .type = KING, .color = color });
-    const bool check = is_in_check(board, color, base_king_pos);
+Position find_cell(ChessBoard board, Cell cell) {
+    PROFILE_BEGIN(call);
+    const Position position = find_cell_unprofiled(board, cell);
+    PROFILE_END(call, PROFILE_FIND_CELL);
+    return position;
+}
+
+static inline Position get_king_position(const GameState* state, PieceColor color) {
+    return position_of(lsb(state->bitboards.pieces[color][KING]));
+}
 
+typedef struct {
+    Square king_square;
+    Bitboard checkers;
+    Bitboard pinned;
+    Bitboard check_mask;  // Where pieces other than the king must land to deal with a check
+} LegalityMasks;
+
+// Computed once per position, so that every move can be validated without playing it
+static LegalityMasks get_legality_masks(const GameState* state, PieceColor color) {
+    const Bitboards* bitboards = &state->bitboards;
+    const PieceColor enemy_color = get_opposite_color(color);
+    const Bitboard* enemies = bitboards->pieces[enemy_color];
+    LegalityMasks masks = { .king_square = lsb(bitboards->pieces[color][KING]) };
+
+    if (attacked_squares(&state->attacks, enemy_color) & square_bb(masks.king_square))
+        masks.checkers = attackers_to(bitboards, masks.king_square, enemy_color, bitboards->occupied);
+    switch (popcount(masks.checkers)) {
+        case 0:  masks.check_mask = ~0ull; break;
+        case 1:  masks.check_mask = masks.checkers | between_bb[masks.king_square][lsb(masks.checkers)]; break;
+        default: masks.check_mask = 0; break;  // Double check, only the king can move
+    }
 
-    for (size_t row = 0; row < 8; row++) {
-        for (size_t col = 0; col < 8; col++) {
-            const Position piece_position = { col, row };
-            const Cell current_piece = get_piece_at(board, piece_position);
+    // Enemy sliders that would see the king if exactly one of our pieces moved away
+    Bitboard snipers = (rook_attacks(masks.king_square, 0) & (enemies[ROOK] | enemies[QWEEN]))
+        | (bishop_attacks(masks.king_square, 0) & (enemies[BISHOP] | enemies[QWEEN]));
 
-            if (current_piece.is_empty || current_piece.color != color) continue;
+    while (snipers) {
+        const Bitboard blockers = between_bb[masks.king_square][pop_lsb(&snipers)] & bitboards->occupied;
+        if (popcount(blockers) == 1) masks.pinned |= blockers & bitboards->colors[color];
+    }
 
-            Position moves_buffer[24];
-            size_t nb_moves = get_possible_moves(board, piece_position, moves_buffer);
+    return masks;
+}
 
-            for (size_t i = 0; i < nb_moves; i++) {
-                const Position real_king_pos = current_piece.type == KING ? moves_buffer[i] : base_king_pos;
-                if (!is_in_check_after_move(board, color, real_king_pos, piece_position, moves_buffer[i])) return true;
+// En passant removes two pieces from the same row at once, which pin masks
+// can't see, so just play it on a copy of the bitboards.
+static bool is_en_passant_legal(const GameState* state, Square king_square, Square start, Square target, PieceColor color) {
+    const PieceColor enemy_color = get_opposite_color(color);
+    const Square captured_square = color == WHITE ? target + 8 : target - 8;
+    const Cell pawn = { color, PAWN };
+
+    Bitboards after_move = state->bitboards;
+    bitboards_remove_piece(&after_move, captured_square, (Cell) { enemy_color, PAWN });
+    bitboards_remove_piece(&after_move, start, pawn);
+    bitboards_put_piece(&after_move, target, pawn);
+    return !is_square_attacked(&after_move, king_square, enemy_color);
+}
+
+static Bitboard get_legal_targets(const GameState* state, const LegalityMasks* masks, Square square, Cell piece) {
+    const Bitboards* bitboards = &state->bitboards;
+    const PieceColor enemy_color = get_opposite_color(piece.color);
+    const Bitboard own_pieces = bitboards->colors[piece.color];
+
+    if (piece.type == KING) {
+        Bitboard targets = king_attacks[square] & ~own_pieces & ~attacked_squares(&state->attacks, enemy_color);
+
+        // The king hides the cells behind itself from the sliders checking it,
+        // they're still attacked once it moves away. The checker itself isn't.
+        const Bitboard* enemies = bitboards->pieces[enemy_color];
+        Bitboard sliders = masks->checkers & (enemies[ROOK] | enemies[BISHOP] | enemies[QWEEN]);
+        while (sliders) {
+            const Square slider = pop_lsb(&sliders);
+            targets &= ~line_bb[square][slider] | square_bb(slider);
+        }
+
+        return targets | castling_targets(state, position_of(square), piece.color);
+    }
+
+    Bitboard targets = piece.type == PAWN
+        ? pawn_push_targets(bitboards, square, piece.color) | (pawn_attacks[piece.color][square] & bitboards->colors[enemy_color])
+        : piece_attacks(piece, square, bitboards->occupied) & ~own_pieces;
+
+    targets &= masks->check_mask;
+    if (masks->pinned & square_bb(square)) targets &= line_bb[masks->king_square][square];
+
+    if (piece.type == PAWN) {
+        const Bitboard en_passant = pawn_attacks[piece.color][square] & en_passant_target(state, piece.color);
+        if (en_passant && is_en_passant_legal(state, masks->king_square, square, lsb(en_passant), piece.color))
+            targets |= en_passant;
+    }
+
+    return targets;
+}
+
+size_t generate_legal_moves(const GameState* state, Move* output) {
+    static const PiecesType promotions[] = { QWEEN, ROOK, BISHOP, KNIGHT };
+    const PieceColor color = state->color_to_play;
+    const LegalityMasks masks = get_legality_masks(state, color);
+    const Bitboard enemies = state->bitboards.colors[get_opposite_color(color)];
+    size_t nb_moves = 0;
+
+    Bitboard pieces = state->bitboards.colors[color];
+    while (pieces) {
+        const Square start = pop_lsb(&pieces);
+        const Position start_pos = position_of(start);
+        const Cell piece = state->board[start_pos.row][start_pos.col];
+        Bitboard targets = get_legal_targets(state, &masks, start, piece);
+
+        while (targets) {
+            const Square end = pop_lsb(&targets);
+            const Position end_pos = position_of(end);
+
+            Move move = { .start = start, .end = end, .promotion = PAWN };
+            if (enemies & square_bb(end)) move.flags |= MOVE_CAPTURE;
+            if (piece.type == KING && abs(end_pos.col - start_pos.col) == 2) move.flags |= MOVE_CASTLE;
+            if (piece.type == PAWN && end_pos.col != start_pos.col && !(enemies & square_bb(end)))
+                move.flags |= MOVE_CAPTURE | MOVE_EN_PASSANT;
+
+            if (piece.type != PAWN || (end_pos.row != 0 && end_pos.row != 7)) {
+                output[nb_moves++] = move;
+                continue;
+            }
+
+            move.flags |= MOVE_PROMOTION;
+            for (size_t i = 0; i < 4; i++) {
+                move.promotion = promotions[i];
+                output[nb_moves++] = move;
             }
         }
     }
 
+    return nb_moves;
+}
+
+static inline bool has_moves_available_unprofiled(const GameState* state, PieceColor color) {
+    const LegalityMasks masks = get_legality_masks(state, color);
+
+    // The king is the most likely to have moves left, try it first
+    const Cell king = { color, KING };
+    if (get_legal_targets(state, &masks, masks.king_square, king)) return true;
+
+    Bitboard pieces = state->bitboards.colors[color] ^ square_bb(masks.king_square);
+    while (pieces) {
+        const Square square = pop_lsb(&pieces);
+        const Position pos = position_of(square);
+        if (get_legal_targets(state, &masks, square, state->board[pos.row][pos.col])) return true;
+    }
+
     return false;
 }
 
-// NOTE: currently assumes the move is legal, but checks if it leads to a self-check
-PlayedMoveStatus try_play_move(ChessBoard board, Position start, Position end) {
-    const Cell original_piece_at_end = get_piece_at(board, end);
-    const Cell moved_piece = get_piece_at(board, start);
-    set_piece_at(board, end, moved_piece);
-    set_piece_at(board, start, EMPTY_CELL);
+bool has_moves_available(const GameState* state, PieceColor color) {
+    PROFILE_BEGIN(call);
+    const bool has_moves = has_moves_available_unprofiled(state, color);
+    PROFILE_END(call, PROFILE_HAS_MOVES_AVAILABLE);
+    return has_moves;
+}
 
-    // Prevent putting yourself in check, and undo move if you did
-    const Position king_position = find_cell(board, (Cell) { color_to_play, KING });
-    bool your_king_in_check = is_in_check(board, color_to_play, king_position);
-    if (your_king_in_check) {
-        set_piece_at(board, start, moved_piece);
-        set_piece_at(board, end, original_piece_at_end);
-        return (PlayedMoveStatus) { true, NO_CHECKS };
+// Filling or emptying a square cuts or extends the rays of the sliders that
+// reach it, past the square. Nothing else changes for the other pieces.
+static inline void update_slider_rays(GameState* state, Square square, bool filled) {
+    const Bitboards* bitboards = &state->bitboards;
+    const Bitboard queens = bitboards->pieces[WHITE][QWEEN] | bitboards->pieces[BLACK][QWEEN];
+    const Bitboard rooks = bitboards->pieces[WHITE][ROOK] | bitboards->pieces[BLACK][ROOK] | queens;
+    const Bitboard bishops = bitboards->pieces[WHITE][BISHOP] | bitboards->pieces[BLACK][BISHOP] | queens;
+    const Bitboard rook_rays = rook_attacks(square, bitboards->occupied);
+    const Bitboard bishop_rays = bishop_attacks(square, bitboards->occupied);
+
+    Bitboard sliders = (rook_rays & rooks) | (bishop_rays & bishops);
+    while (sliders) {
+        const Square slider = pop_lsb(&sliders);
+        const Bitboard behind = (rook_rays | bishop_rays) & line_bb[slider][square]
+            & ~between_bb[slider][square] & ~square_bb(slider);
+        const PieceColor color = bitboards->colors[WHITE] & square_bb(slider) ? WHITE : BLACK;
+        if (filled) attack_maps_remove(&state->attacks, color, behind);
+        else attack_maps_add(&state->attacks, color, behind);
     }
+}
 
-    // Casteling
-    bool* long_castle = color_to_play == WHITE
-        ? &white_long_can_castle
-        : &black_long_can_castle;
+// Kings aren't features, moving one refreshes its side instead
+static inline void update_nnue(GameState* state, Square square, Cell piece, bool added) {
+    if (state->nnue.network != NULL && piece.type != KING)
+        nnue_update(&state->nnue, &state->bitboards, square, piece, added);
+}
 
-    bool* short_castle = color_to_play == WHITE
-        ? &white_short_can_castle
-        : &black_short_can_castle;
+// Every change to the pieces goes through these, they keep the board, the
+// bitboards, the attack maps, the hash and the NNUE accumulator in sync.
+// `unmake_move` plays them backwards, which brings the attack maps back exactly.
+static inline void put_piece(GameState* state, Square square, Cell piece) {
+    update_slider_rays(state, square, true);
+    bitboards_put_piece(&state->bitboards, square, piece);
+    attack_maps_add(&state->attacks, piece.color, piece_attacks(piece, square, state->bitboards.occupied));
+    state->board[square >> 3][square & 7] = piece;
+    state->hash ^= zobrist_piece(piece, square);
+    update_nnue(state, square, piece, true);
+}
 
-    if (moved_piece.type == KING && end.col == 1 && *long_castle) {
-        const Position corner = { .row = end.row, .col = 0 };
-        const Position new_pos_rook = { .row = end.row, .col = 2 };
-        const Cell rook = { .color = color_to_play, .type = ROOK };
+static inline void remove_piece(GameState* state, Square square, Cell piece) {
+    attack_maps_remove(&state->attacks, piece.color, piece_attacks(piece, square, state->bitboards.occupied));
+    bitboards_remove_piece(&state->bitboards, square, piece);
+    update_slider_rays(state, square, false);
+    state->board[square >> 3][square & 7] = EMPTY_CELL;
+    state->hash ^= zobrist_piece(piece, square);
+    update_nnue(state, square, piece, false);
+}
+
+static inline void move_piece(GameState* state, Square start, Square end, Cell piece) {
+    remove_piece(state, start, piece);
+    put_piece(state, end, piece);
+}
+
+// A capture leaves the square filled, the sliders going through it don't change
+static inline void replace_piece(GameState* state, Square square, Cell captured_piece, Cell piece) {
+    const Bitboard occupied = state->bitboards.occupied;
+    attack_maps_remove(&state->attacks, captured_piece.color, piece_attacks(captured_piece, square, occupied));
+    bitboards_remove_piece(&state->bitboards, square, captured_piece);
+    bitboards_put_piece(&state->bitboards, square, piece);
+    attack_maps_add(&state->attacks, piece.color, piece_attacks(piece, square, occupied));
+    state->board[square >> 3][square & 7] = piece;
+    state->hash ^= zobrist_piece(captured_piece, square) ^ zobrist_piece(piece, square);
+    update_nnue(state, square, captured_piece, false);
+    update_nnue(state, square, piece, true);
+}
 
-        set_piece_at(board, corner, EMPTY_CELL);
-        set_piece_at(board, new_pos_rook, rook);
-        *long_castle = false;
-        *short_castle = false;
+static inline void refresh_nnue_after_king_move(GameState* state, Cell moved_piece) {
+    if (state->nnue.network != NULL && moved_piece.type == KING)
+        nnue_refresh(&state->nnue, &state->bitboards, moved_piece.color);
+}
+
+// A rook leaving its corner, or getting captured there, loses its castling right
+static void clear_castling_right_at(GameState* state, Position pos) {
+    if (pos.row == 7 && pos.col == 0) state->castling_rights &= ~WHITE_LONG_CASTLE;
+    if (pos.row == 7 && pos.col == 7) state->castling_rights &= ~WHITE_SHORT_CASTLE;
+    if (pos.row == 0 && pos.col == 0) state->castling_rights &= ~BLACK_LONG_CASTLE;
+    if (pos.row == 0 && pos.col == 7) state->castling_rights &= ~BLACK_SHORT_CASTLE;
+}
+
+// NOTE: doesn't check anything, the move has to be legal
+void make_move(GameState* state, Move move) {
+    const PieceColor color_to_play = state->color_to_play;
+    const Position start = position_of(move.start);
+    const Position end = position_of(move.end);
+    const Cell moved_piece = get_piece_at(state->board, start);
+    const Cell original_piece_at_end = get_piece_at(state->board, end);
+    const Position en_passant_pawn = { .col = end.col, .row = start.row };
+
+    move.flags = original_piece_at_end.is_empty ? 0 : MOVE_CAPTURE;
+    if (moved_piece.type == KING && abs(end.col - start.col) == 2) move.flags |= MOVE_CASTLE;
+    if (moved_piece.type == PAWN && start.col != end.col && original_piece_at_end.is_empty)
+        move.flags |= MOVE_CAPTURE | MOVE_EN_PASSANT;
+
+    if (moved_piece.type == PAWN && (end.row == 0 || end.row == 7)) {
+        move.flags |= MOVE_PROMOTION;
+        if (move.promotion == PAWN || move.promotion == KING) move.promotion = QWEEN;
+    }
+
+    state->undo_stack[state->undo_top] = (UndoRecord) {
+        .move = move,
+        .captured_piece = move.flags & MOVE_EN_PASSANT ? get_piece_at(state->board, en_passant_pawn) : original_piece_at_end,
+        .castling_rights = state->castling_rights,
+        .king_status = state->king_status,
+        .last_move = state->last_move,
+        .halfmove_clock = state->halfmove_clock,
+        .hash = state->hash,
+    };
+    state->hash ^= en_passant_hash(state) ^ zobrist_castling[state->castling_rights];
+
+    const UndoRecord* record = &state->undo_stack[state->undo_top];
+    state->dirty_squares = square_bb(move.start) | square_bb(move.end);
+    if (move.flags & MOVE_EN_PASSANT) {
+        remove_piece(state, square_of(en_passant_pawn), record->captured_piece);
+        state->dirty_squares |= square_bb(square_of(en_passant_pawn));
     }
 
-    if (moved_piece.type == KING && end.col == 6 && *short_castle) {
-        const Position corner = { .row = end.row, .col = 7 };
-        const Position new_pos_rook = { .row = end.row, .col = 5 };
+    // Promotion
+    const Cell landing_piece = move.flags & MOVE_PROMOTION ? (Cell) { color_to_play, move.promotion } : moved_piece;
+    remove_piece(state, move.start, moved_piece);
+    if ((move.flags & (MOVE_CAPTURE | MOVE_EN_PASSANT)) == MOVE_CAPTURE)
+        replace_piece(state, move.end, original_piece_at_end, landing_piece);
+    else
+        put_piece(state, move.end, landing_piece);
+
+    // Casteling
+    if (move.flags & MOVE_CASTLE) {
+        const Position corner = { .row = end.row, .col = end.col < start.col ? 0 : 7 };
+        const Position new_pos_rook = { .row = end.row, .col = (start.col + end.col) / 2 };
         const Cell rook = { .color = color_to_play, .type = ROOK };
+        move_piece(state, square_of(corner), square_of(new_pos_rook), rook);
+        state->dirty_squares |= square_bb(square_of(corner)) | square_bb(square_of(new_pos_rook));
+    }
+
+    if (moved_piece.type == KING)
+        state->castling_rights &= ~(short_castle_right(color_to_play) | long_castle_right(color_to_play));
+
+    clear_castling_right_at(state, start);
+    clear_castling_right_at(state, end);
+    refresh_nnue_after_king_move(state, moved_piece);
+
+    state->halfmove_clock = moved_piece.type == PAWN || (move.flags & MOVE_CAPTURE) ? 0 : state->halfmove_clock + 1;
+    if (color_to_play == BLACK) state->fullmove_number++;
 
-        set_piece_at(board, corner, EMPTY_CELL);
-        set_piece_at(board, new_pos_rook, rook);
-        *long_castle = false;
-        *short_castle = false;
+    state->last_move.moved_piece = moved_piece;
+    state->last_move.start_position = start;
+    state->last_move.end_position = end;
+
+    state->color_to_play = get_opposite_color(color_to_play);
+    state->hash ^= zobrist_black_to_play ^ zobrist_castling[state->castling_rights] ^ en_passant_hash(state);
+
+    state->undo_top = (state->undo_top + 1) % UNDO_STACK_SIZE;
+    if (state->nb_undo_records < UNDO_STACK_SIZE) state->nb_undo_records++;
+}
+
+// Returns false if there is no move left to take back
+bool unmake_move(GameState* state) {
+    if (state->nb_undo_records == 0) return false;
+    state->nb_undo_records--;
+    state->undo_top = (state->undo_top + UNDO_STACK_SIZE - 1) % UNDO_STACK_SIZE;
+
+    const UndoRecord* record = &state->undo_stack[state->undo_top];
+    const Move move = record->move;
+    const PieceColor color_to_play = get_opposite_color(state->color_to_play);
+    const Position start = position_of(move.start);
+    const Position end = position_of(move.end);
+
+    // The same updates as `make_move`, in the opposite order
+    const Cell landing_piece = get_piece_at(state->board, end);
+    const Cell moved_piece = move.flags & MOVE_PROMOTION ? (Cell) { color_to_play, PAWN } : landing_piece;
+    state->dirty_squares = square_bb(move.start) | square_bb(move.end);
+    if (move.flags & MOVE_CASTLE) {
+        const Position corner = { .row = end.row, .col = end.col < start.col ? 0 : 7 };
+        const Position new_pos_rook = { .row = end.row, .col = (start.col + end.col) / 2 };
+        const Cell rook = { .color = color_to_play, .type = ROOK };
+        move_piece(state, square_of(new_pos_rook), square_of(corner), rook);
+        state->dirty_squares |= square_bb(square_of(corner)) | square_bb(square_of(new_pos_rook));
     }
 
-    if (moved_piece.type == ROOK && start.col == 0) *long_castle = false;
-    if (moved_piece.type == ROOK && start.col == 7) *short_castle = false;
+    if ((move.flags & (MOVE_CAPTURE | MOVE_EN_PASSANT)) == MOVE_CAPTURE)
+        replace_piece(state, move.end, landing_piece, record->captured_piece);
+    else
+        remove_piece(state, move.end, landing_piece);
+    put_piece(state, move.start, moved_piece);
 
-    // Promotion
-    if (moved_piece.type == PAWN && (end.row == 0 || end.row == 7)) {
-        const Cell qween = { moved_piece.color, QWEEN };
-        set_piece_at(board, end, qween);
+    if (move.flags & MOVE_EN_PASSANT) {
+        const Square captured_square = square_of((Position) { .col = end.col, .row = start.row });
+        put_piece(state, captured_square, record->captured_piece);
+        state->dirty_squares |= square_bb(captured_square);
     }
+    refresh_nnue_after_king_move(state, moved_piece);
+
+    state->castling_rights = record->castling_rights;
+    state->king_status = record->king_status;
+    state->last_move = record->last_move;
+    state->halfmove_clock = record->halfmove_clock;
+    state->hash = record->hash;  // Cheaper than taking back the castling and en passant keys
+    if (color_to_play == BLACK) state->fullmove_number--;
+    state->color_to_play = color_to_play;
+    return true;
+}
 
-    // En passant
-    if (last_move.moved_piece.type == PAWN &&
-        abs(last_move.start_position.row - last_move.end_position.row) == 2 &&
-        last_move.start_position.col == end.col &&
-        (last_move.start_position.row + last_move.end_position.row) / 2 == end.row
-    ) {
-        set_piece_at(board, last_move.end_position, EMPTY_CELL);
+// How many times the current position already happened. Only the positions
+// since the last capture or pawn move can match, and only with the same side
+// to play.
+u8 count_repetitions(const GameState* state) {
+    const u16 nb_plies = state->halfmove_clock < state->nb_undo_records ? state->halfmove_clock : state->nb_undo_records;
+    u8 count = 0;
+    for (u16 ply = 2; ply <= nb_plies; ply += 2) {
+        const UndoRecord* record = &state->undo_stack[(state->undo_top + UNDO_STACK_SIZE - ply) % UNDO_STACK_SIZE];
+        if (record->hash == state->hash) count++;
     }
+    return count;
+}
 
-    PieceColor enemy_color = get_opposite_color(color_to_play);
-    const Position enemy_king_position = find_cell(board, (Cell) { enemy_color, KING });
-    bool enemy_king_in_check = is_in_check(board, enemy_color, enemy_king_position);
+// NOTE: assumes the move comes from `get_possible_moves`, but checks if it leads to a self-check
+static PlayedMoveStatus try_play_move_unprofiled(GameState* state, Position start, Position end) {
+    const PieceColor color_to_play = state->color_to_play;
+    const Cell moved_piece = get_piece_at(state->board, start);
+
+    // Prevent putting yourself in check
+    const Position king_position = moved_piece.type == KING ? end : get_king_position(state, color_to_play);
+    if (is_in_check_after_move(state, color_to_play, king_position, start, end))
+        return (PlayedMoveStatus) { true, NO_CHECKS };
 
-    last_move.moved_piece = moved_piece;
-    last_move.start_position = start;
-    last_move.end_position = end;
+    make_move(state, (Move) { .start = square_of(start), .end = square_of(end), .promotion = QWEEN });
 
-    color_to_play = get_opposite_color(color_to_play);
+    PieceColor enemy_color = get_opposite_color(color_to_play);
+    const Position enemy_king_position = get_king_position(state, enemy_color);
+    bool enemy_king_in_check = is_in_check(state, enemy_color, enemy_king_position);
+    const bool enemy_has_moves = has_moves_available(state, enemy_color);
+
+    if (enemy_king_in_check) {
+        state->king_status = enemy_has_moves ? CHECK : CHECK_MATE;
+        return (PlayedMoveStatus) { false, state->king_status, false };
+    }
 
-    if (enemy_king_in_check)
-        return has_moves_available(board, enemy_color)
-            ? (PlayedMoveStatus) { false, CHECK, false }
-            : (PlayedMoveStatus) { false, CHECK_MATE, false };
+    state->king_status = NO_CHECKS;
+    return (PlayedMoveStatus) { false, NO_CHECKS, !enemy_has_moves };
+}
 
-    return has_moves_available(board, enemy_color)
-        ? (PlayedMoveStatus) { false, NO_CHECKS, false }
-        : (PlayedMoveStatus) { false, NO_CHECKS, true };
+PlayedMoveStatus try_play_move(GameState* state, Position start, Position end) {
+    PROFILE_BEGIN(call);
+    const PlayedMoveStatus status = try_play_move_unprofiled(state, start, end);
+    PROFILE_END(call, PROFILE_TRY_PLAY_MOVE);
+    return status;
 }
 
 void debug_log_chess_board(ChessBoard board) {
@@ -0,0 +1,134 @@
+// vim:ft=c
+#pragma once
+
+#include "common_types.h"
+#include "bitboard.h"
+#include "nnue.h"
+
+// No position has more legal moves than that (the record is 218)
+#define MAX_MOVES 256
+
+typedef enum: u8 {
+    MOVE_CAPTURE    = 1 << 0,
+    MOVE_CASTLE     = 1 << 1,
+    MOVE_EN_PASSANT = 1 << 2,
+    MOVE_PROMOTION  = 1 << 3,
+} MoveFlags;
+
+typedef struct {
+    Square start;
+    Square end;
+    PiecesType promotion;  // Only meaningful with MOVE_PROMOTION
+    u8 flags;              // MoveFlags
+} Move;
+
+typedef enum: u8 {
+    WHITE_SHORT_CASTLE = 1 << 0,
+    WHITE_LONG_CASTLE  = 1 << 1,
+    BLACK_SHORT_CASTLE = 1 << 2,
+    BLACK_LONG_CASTLE  = 1 << 3,
+} CastlingRights;
+
+#define ALL_CASTLING_RIGHTS (WHITE_SHORT_CASTLE | WHITE_LONG_CASTLE | BLACK_SHORT_CASTLE | BLACK_LONG_CASTLE)
+
+static inline CastlingRights short_castle_right(PieceColor color) {
+    return color == WHITE ? WHITE_SHORT_CASTLE : BLACK_SHORT_CASTLE;
+}
+
+static inline CastlingRights long_castle_right(PieceColor color) {
+    return color == WHITE ? WHITE_LONG_CASTLE : BLACK_LONG_CASTLE;
+}
+
+// What a dirty square holds now, EMPTY_CELL if it was emptied
+typedef struct {
+    Position position;
+    Cell piece;
+} SquareChange;
+
+// A castling moves two pieces, an en passant capture empties a third square
+#define MAX_MOVE_CHANGES 4
+
+typedef struct {
+    Cell moved_piece;
+    Position start_position;
+    Position end_position;
+} LastMove;
+
+// What `make_move` overwrites, so that `unmake_move` can put it back
+typedef struct {
+    Move move;  // With its flags filled in, whatever the caller passed
+    Cell captured_piece;
+    u8 castling_rights;
+    KingStatus king_status;
+    LastMove last_move;  // Holds the en passant target
+    u16 halfmove_clock;
+    u64 hash;
+} UndoRecord;
+
+// Past this many moves, the oldest ones can't be unmade anymore
+#define UNDO_STACK_SIZE 1024
+
+// Everything needed to play one game. Nothing in the library is shared between
+// two states, so different states can be used from different threads.
+typedef struct {
+    ChessBoard board;
+    Bitboards bitboards;  // Always kept in sync with `board`
+    AttackMaps attacks;   // Same, checks and attacked squares are single lookups
+
+    // Squares changed by the last `make_move` or `unmake_move`, all of them
+    // after a new position is set. Redraws only need those.
+    Bitboard dirty_squares;
+
+    PieceColor color_to_play;
+    KingStatus king_status;
+
+    u8 castling_rights;  // CastlingRights
+
+    LastMove last_move;
+    u16 halfmove_clock;  // Moves since the last capture or pawn move
+    u16 fullmove_number;
+
+    // Zobrist hash, updated by `make_move`. The en passant column is only
+    // part of it when a pawn can actually take.
+    u64 hash;
+
+    // Only maintained once a network is attached with `set_nnue_network`
+    NnueAccumulator nnue;
+
+    // Ring buffer, `undo_top` is where the next record goes
+    UndoRecord undo_stack[UNDO_STACK_SIZE];
+    u16 undo_top;
+    u16 nb_undo_records;
+} GameState;
+
+GameState* game_state_create(void);
+GameState* game_state_clone(const GameState* state);
+void game_state_destroy(GameState* state);
+
+ChessBoard* get_chess_board(GameState* state);
+PieceColor get_color_to_play(const GameState* state);
+u64 get_hash(const GameState* state);
+u64 compute_hash(const GameState* state);
+i8 get_en_passant_column(const GameState* state);
+void set_nnue_network(GameState* state, const NnueNetwork* network);
+
+// The dirty squares with their content, MAX_MOVE_CHANGES of them at most after
+// a move but up to 64 after a new position
+Bitboard get_dirty_squares(const GameState* state);
+size_t get_board_changes(const GameState* state, SquareChange* output);
+
+Cell get_piece_at(ChessBoard board, Position pos);
+void set_piece_at(ChessBoard board, Position pos, Cell piece);
+Position find_cell(ChessBoard board, Cell cell);
+
+size_t get_possible_moves(const GameState* state, Position pos, Position* output);
+bool is_in_check(const GameState* state, PieceColor king_color, Position king_position);
+bool is_in_check_after_move(const GameState* state, PieceColor king_color, Position king_position, Position start, Position end);
+bool has_moves_available(const GameState* state, PieceColor color);
+size_t generate_legal_moves(const GameState* state, Move* output);
+void make_move(GameState* state, Move move);
+bool unmake_move(GameState* state);
+u8 count_repetitions(const GameState* state);
+PlayedMoveStatus try_play_move(GameState* state, Position start, Position end);
+
+void debug_log_chess_board(ChessBoard board);
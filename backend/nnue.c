@@ -0,0 +1,194 @@
+#include <stdalign.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+#include "nnue.h"
+
+#define NNUE_MAGIC 0x31554E4E53534843ull  // "CHSSNNU1"
+
+// Activations are clipped to [0, 127], which stands for 1.0, and the i8 weights
+// after the hidden layer are in 1/64ths, so each layer's sums are shifted back
+// by 6. The output isn't: its raw sum is in pawns times 127 * 64.
+#define ACTIVATION_MAX 127
+#define WEIGHT_SHIFT 6
+#define OUTPUT_SCALE (ACTIVATION_MAX << WEIGHT_SHIFT)  // Raw output per pawn
+
+struct NnueNetwork {
+    alignas(64) i16 hidden_weights[NNUE_INPUTS][NNUE_HIDDEN];
+    alignas(64) i16 hidden_biases[NNUE_HIDDEN];
+    alignas(64) i8 layer_1_weights[NNUE_LAYER_SIZE][2 * NNUE_HIDDEN];
+    alignas(64) i8 layer_2_weights[NNUE_LAYER_SIZE][NNUE_LAYER_SIZE];
+    alignas(64) i8 output_weights[NNUE_LAYER_SIZE];
+    i32 layer_1_biases[NNUE_LAYER_SIZE];
+    i32 layer_2_biases[NNUE_LAYER_SIZE];
+    i32 output_bias;
+};
+
+static bool read_array(FILE* file, void* output, size_t size, size_t count) {
+    return fread(output, size, count, file) == count;
+}
+
+NnueNetwork* nnue_load(const char* path) {
+    NnueNetwork* network = aligned_alloc(64, sizeof(NnueNetwork));
+    if (network == NULL) return NULL;
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) goto error;
+
+    u64 magic;
+    const bool ok = read_array(file, &magic, sizeof(magic), 1) && magic == NNUE_MAGIC
+        && read_array(file, network->hidden_biases, sizeof(i16), NNUE_HIDDEN)
+        && read_array(file, network->hidden_weights, sizeof(i16), (size_t) NNUE_INPUTS * NNUE_HIDDEN)
+        && read_array(file, network->layer_1_biases, sizeof(i32), NNUE_LAYER_SIZE)
+        && read_array(file, network->layer_1_weights, sizeof(i8), NNUE_LAYER_SIZE * 2 * NNUE_HIDDEN)
+        && read_array(file, network->layer_2_biases, sizeof(i32), NNUE_LAYER_SIZE)
+        && read_array(file, network->layer_2_weights, sizeof(i8), NNUE_LAYER_SIZE * NNUE_LAYER_SIZE)
+        && read_array(file, &network->output_bias, sizeof(i32), 1)
+        && read_array(file, network->output_weights, sizeof(i8), NNUE_LAYER_SIZE)
+        && fgetc(file) == EOF;
+    fclose(file);
+    if (!ok) goto error;
+    return network;
+
+error:
+    free(network);
+    return NULL;
+}
+
+void nnue_destroy(NnueNetwork* network) {
+    free(network);
+}
+
+// Pieces are "ours" or "theirs" from the side, and rows are flipped for black
+static inline size_t feature_index(PieceColor side, Square king_square, Square square, Cell piece) {
+    const u8 flip = side == WHITE ? 0 : 56;
+    const size_t piece_index = (piece.color != side) * 5 + piece.type;
+    return ((size_t) (king_square ^ flip) * 10 + piece_index) * 64 + (square ^ flip);
+}
+
+// The accumulator rows aren't aligned: states live anywhere
+static inline void add_row(i16* values, const i16* row) {
+#if defined(__AVX2__)
+    for (size_t i = 0; i < NNUE_HIDDEN; i += 16) {
+        const __m256i sum = _mm256_add_epi16(_mm256_loadu_si256((const __m256i*) &values[i]), _mm256_load_si256((const __m256i*) &row[i]));
+        _mm256_storeu_si256((__m256i*) &values[i], sum);
+    }
+#else
+    for (size_t i = 0; i < NNUE_HIDDEN; i++) values[i] += row[i];
+#endif
+}
+
+static inline void subtract_row(i16* values, const i16* row) {
+#if defined(__AVX2__)
+    for (size_t i = 0; i < NNUE_HIDDEN; i += 16) {
+        const __m256i difference = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i*) &values[i]), _mm256_load_si256((const __m256i*) &row[i]));
+        _mm256_storeu_si256((__m256i*) &values[i], difference);
+    }
+#else
+    for (size_t i = 0; i < NNUE_HIDDEN; i++) values[i] -= row[i];
+#endif
+}
+
+void nnue_refresh(NnueAccumulator* accumulator, const Bitboards* bitboards, PieceColor side) {
+    const NnueNetwork* network = accumulator->network;
+    i16* values = accumulator->values[side];
+    const Square king_square = lsb(bitboards->pieces[side][KING]);
+    memcpy(values, network->hidden_biases, sizeof(network->hidden_biases));
+
+    Bitboard pieces = bitboards->occupied & ~(bitboards->pieces[WHITE][KING] | bitboards->pieces[BLACK][KING]);
+    while (pieces) {
+        const Square square = pop_lsb(&pieces);
+        const Cell piece = bitboards_piece_at(bitboards, square);
+        add_row(values, network->hidden_weights[feature_index(side, king_square, square, piece)]);
+    }
+}
+
+void nnue_update(NnueAccumulator* accumulator, const Bitboards* bitboards, Square square, Cell piece, bool added) {
+    const NnueNetwork* network = accumulator->network;
+    for (PieceColor side = WHITE; side <= BLACK; side++) {
+        // A king in the middle of its move gets its side refreshed afterwards
+        if (bitboards->pieces[side][KING] == 0) continue;
+        const Square king_square = lsb(bitboards->pieces[side][KING]);
+        const i16* row = network->hidden_weights[feature_index(side, king_square, square, piece)];
+        if (added) add_row(accumulator->values[side], row);
+        else subtract_row(accumulator->values[side], row);
+    }
+}
+
+static inline u8 clip(i32 value) {
+    return value < 0 ? 0 : value > ACTIVATION_MAX ? ACTIVATION_MAX : value;
+}
+
+// Side to play first, then the other one
+static void hidden_activations(const NnueAccumulator* accumulator, PieceColor color_to_play, u8* output) {
+    for (size_t side = 0; side < 2; side++) {
+        const i16* values = accumulator->values[side == 0 ? color_to_play : color_to_play ^ 1];
+        u8* side_output = &output[side * NNUE_HIDDEN];
+#if defined(__AVX2__)
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i max = _mm256_set1_epi16(ACTIVATION_MAX);
+        for (size_t i = 0; i < NNUE_HIDDEN; i += 32) {
+            const __m256i low = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*) &values[i]), zero), max);
+            const __m256i high = _mm256_min_epi16(_mm256_max_epi16(_mm256_loadu_si256((const __m256i*) &values[i + 16]), zero), max);
+            // packus works per 128-bit lane, put the quarters back in order
+            const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8);
+            _mm256_storeu_si256((__m256i*) &side_output[i], packed);
+        }
+#else
+        for (size_t i = 0; i < NNUE_HIDDEN; i++) side_output[i] = clip(values[i]);
+#endif
+    }
+}
+
+// u8 inputs times i8 weights. Both sizes are multiples of 32.
+static i32 dot_product(const u8* inputs, const i8* weights, size_t size) {
+#if defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sums = _mm256_setzero_si256();
+    for (size_t i = 0; i < size; i += 32) {
+        const __m256i products = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*) &inputs[i]),
+            _mm256_load_si256((const __m256i*) &weights[i]));
+        sums = _mm256_add_epi32(sums, _mm256_madd_epi16(products, ones));
+    }
+    const __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    const __m128i quarter = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+    return _mm_cvtsi128_si32(_mm_add_epi32(quarter, _mm_shuffle_epi32(quarter, 0xB1)));
+#elif defined(__SSSE3__)
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sums = _mm_setzero_si128();
+    for (size_t i = 0; i < size; i += 16) {
+        const __m128i products = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*) &inputs[i]),
+            _mm_load_si128((const __m128i*) &weights[i]));
+        sums = _mm_add_epi32(sums, _mm_madd_epi16(products, ones));
+    }
+    const __m128i half = _mm_add_epi32(sums, _mm_shuffle_epi32(sums, 0x4E));
+    return _mm_cvtsi128_si32(_mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1)));
+#else
+    i32 sum = 0;
+    for (size_t i = 0; i < size; i++) sum += inputs[i] * weights[i];
+    return sum;
+#endif
+}
+
+static void affine_layer(const u8* inputs, size_t nb_inputs, const i8* weights, const i32* biases, u8* output) {
+    for (size_t i = 0; i < NNUE_LAYER_SIZE; i++)
+        output[i] = clip((biases[i] + dot_product(inputs, &weights[i * nb_inputs], nb_inputs)) >> WEIGHT_SHIFT);
+}
+
+i32 nnue_evaluate(const NnueAccumulator* accumulator, PieceColor color_to_play) {
+    const NnueNetwork* network = accumulator->network;
+    alignas(32) u8 hidden[2 * NNUE_HIDDEN];
+    alignas(32) u8 layer_1[NNUE_LAYER_SIZE];
+    alignas(32) u8 layer_2[NNUE_LAYER_SIZE];
+
+    hidden_activations(accumulator, color_to_play, hidden);
+    affine_layer(hidden, 2 * NNUE_HIDDEN, &network->layer_1_weights[0][0], network->layer_1_biases, layer_1);
+    affine_layer(layer_1, NNUE_LAYER_SIZE, &network->layer_2_weights[0][0], network->layer_2_biases, layer_2);
+    const i64 output = network->output_bias + dot_product(layer_2, network->output_weights, NNUE_LAYER_SIZE);
+    return output * 100 / OUTPUT_SCALE;
+}
@@ -0,0 +1,45 @@
+// vim:ft=c
+#pragma once
+
+#include "common_types.h"
+#include "bitboard.h"
+
+// HalfKP: one input per (own king square, piece other than a king, square),
+// seen from each side. Black's side is flipped, so that both sides see their
+// own pieces at the bottom.
+#define NNUE_INPUTS (64 * 10 * 64)
+#define NNUE_HIDDEN 256  // Per side
+#define NNUE_LAYER_SIZE 32
+
+// The weights, loaded as is from a file made of, little endian:
+//   u64 magic "CHSSNNU1"
+//   i16 hidden_biases[NNUE_HIDDEN]
+//   i16 hidden_weights[NNUE_INPUTS][NNUE_HIDDEN]
+//   i32 layer_1_biases[NNUE_LAYER_SIZE]
+//   i8  layer_1_weights[NNUE_LAYER_SIZE][2 * NNUE_HIDDEN]
+//   i32 layer_2_biases[NNUE_LAYER_SIZE]
+//   i8  layer_2_weights[NNUE_LAYER_SIZE][NNUE_LAYER_SIZE]
+//   i32 output_bias
+//   i8  output_weights[NNUE_LAYER_SIZE]
+// Activations are in 1/127ths and the i8 weights in 1/64ths, so the output
+// layer's bias is in pawns times 127 * 64.
+typedef struct NnueNetwork NnueNetwork;
+
+// The first layer's output for both sides, kept up to date by make/unmake
+// while `network` isn't NULL
+typedef struct {
+    i16 values[2][NNUE_HIDDEN];  // [PieceColor of the side]
+    const NnueNetwork* network;
+} NnueAccumulator;
+
+NnueNetwork* nnue_load(const char* path);
+void nnue_destroy(NnueNetwork* network);
+
+// From scratch, for one side. Needed whenever that side's king moves.
+void nnue_refresh(NnueAccumulator* accumulator, const Bitboards* bitboards, PieceColor side);
+
+// A piece other than a king appeared or disappeared on `square`, for both sides
+void nnue_update(NnueAccumulator* accumulator, const Bitboards* bitboards, Square square, Cell piece, bool added);
+
+// Centipawns, from the side to play's point of view
+i32 nnue_evaluate(const NnueAccumulator* accumulator, PieceColor color_to_play);
@@ -0,0 +1,66 @@
+#include <string.h>
+
+#include "packed.h"
+
+void pack_position(const GameState* state, PackedPosition* output) {
+    *output = (PackedPosition) {
+        .occupied = state->bitboards.occupied,
+        .flags = (state->color_to_play == BLACK) | state->castling_rights << 1,
+        .en_passant = NO_EN_PASSANT,
+        .halfmove_clock = state->halfmove_clock,
+        .fullmove_number = state->fullmove_number,
+    };
+
+    const i8 en_passant_col = get_en_passant_column(state);
+    if (en_passant_col >= 0) output->en_passant = en_passant_col;
+
+    Bitboard occupied = state->bitboards.occupied;
+    for (size_t i = 0; occupied; i++) {
+        const Square square = pop_lsb(&occupied);
+        const Cell piece = state->board[square >> 3][square & 7];
+        output->pieces[i / 2] |= (piece.color << 3 | piece.type) << (i % 2 * 4);
+    }
+}
+
+bool unpack_position(const PackedPosition* position, GameState* output) {
+    if (popcount(position->occupied) > 32 || position->en_passant > NO_EN_PASSANT) return false;
+
+    ChessBoard board;
+    for (Square square = 0; square < 64; square++) board[square >> 3][square & 7] = EMPTY_CELL;
+
+    Bitboard occupied = position->occupied;
+    for (size_t i = 0; occupied; i++) {
+        const Square square = pop_lsb(&occupied);
+        const u8 code = position->pieces[i / 2] >> (i % 2 * 4) & 15;
+        if ((code & 7) > KING) return false;
+        board[square >> 3][square & 7] = (Cell) { .color = code >> 3, .type = code & 7 };
+    }
+
+    memcpy(output->board, board, sizeof(ChessBoard));
+    bitboards_from_chess_board(output->board, &output->bitboards);
+    attack_maps_from_bitboards(&output->bitboards, &output->attacks);
+    output->dirty_squares = ~0ull;
+    output->color_to_play = position->flags & 1 ? BLACK : WHITE;
+    output->king_status = NO_CHECKS;
+    output->castling_rights = position->flags >> 1 & ALL_CASTLING_RIGHTS;
+    output->halfmove_clock = position->halfmove_clock;
+    output->fullmove_number = position->fullmove_number;
+
+    // Like FENs, the en passant target is kept as the pawn move that created it
+    output->last_move = (LastMove) {0};
+    if (position->en_passant != NO_EN_PASSANT) {
+        const PieceColor pawn_color = output->color_to_play == WHITE ? BLACK : WHITE;
+        const i8 start_row = pawn_color == WHITE ? 6 : 1;
+        output->last_move = (LastMove) {
+            .moved_piece = { pawn_color, PAWN },
+            .start_position = { .col = position->en_passant, .row = start_row },
+            .end_position = { .col = position->en_passant, .row = pawn_color == WHITE ? 4 : 3 },
+        };
+    }
+
+    output->hash = compute_hash(output);
+    output->undo_top = 0;
+    output->nb_undo_records = 0;
+    output->nnue.network = NULL;
+    return true;
+}
@@ -0,0 +1,39 @@
+// vim:ft=c
+#pragma once
+
+#include <assert.h>
+
+#include "lib.h"
+
+// A whole position in 32 bytes. Equal positions always give the same bytes:
+// unused piece codes and padding are zero, and the en passant column is only
+// kept when a pawn can take, like in the Zobrist hash.
+typedef struct {
+    Bitboard occupied;
+    u8 pieces[16];  // One 4-bit code per occupied square in square order, `color << 3 | type`
+    u8 flags;       // Bit 0: black to play, bits 1 to 4: CastlingRights
+    u8 en_passant;  // Column of the en passant target, NO_EN_PASSANT if none
+    u16 halfmove_clock;
+    u16 fullmove_number;
+    u8 padding[2];
+} PackedPosition;
+
+#define NO_EN_PASSANT 8
+
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must stay 32 bytes");
+
+// 6 bits start, 6 bits end, 3 bits promotion (PAWN for none). make_move fills
+// in the flags again.
+typedef u16 PackedMove;
+
+static inline PackedMove pack_move(Move move) {
+    const PiecesType promotion = move.flags & MOVE_PROMOTION ? move.promotion : PAWN;
+    return move.start | move.end << 6 | promotion << 12;
+}
+
+static inline Move unpack_move(PackedMove move) {
+    return (Move) { .start = move & 63, .end = (move >> 6) & 63, .promotion = (move >> 12) & 7 };
+}
+
+void pack_position(const GameState* state, PackedPosition* output);
+bool unpack_position(const PackedPosition* position, GameState* output);
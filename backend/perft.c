@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lib.h"
+#include "book.h"
+#include "eval.h"
+#include "fen.h"
+#include "pgn.h"
+#include "profile.h"
+
+typedef struct {
+    const char* name;
+    const char* fen;
+    u8 depth;
+    u64 nodes;
+} PerftCase;
+
+// Reference counts from the Chess Programming Wiki, plus the usual rules
+// edge cases (en passant pins, castling through check, under-promotions...).
+static const PerftCase perft_suite[] = {
+    { "start position",           STARTING_FEN, 5, 4865609 },
+    { "kiwipete",                 "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603 },
+    { "en passant pins",          "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624 },
+    { "promotions",               "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333 },
+    { "promotion with check",     "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487 },
+    { "middle game",              "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594 },
+    { "illegal en passant 1",     "3k4/3p4/8/K1P4r/8/8/8/8 b - - 0 1", 6, 1134888 },
+    { "illegal en passant 2",     "8/8/4k3/8/2p5/8/B2P2K1/8 w - - 0 1", 6, 1015133 },
+    { "en passant gives check",   "8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467 },
+    { "short castle gives check", "5k2/8/8/8/8/8/8/4K2R w K - 0 1", 6, 661072 },
+    { "long castle gives check",  "3k4/8/8/8/8/8/8/R3K3 w Q - 0 1", 6, 803711 },
+    { "castling rights",          "r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206 },
+    { "castling prevented",       "r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476 },
+    { "promote out of check",     "2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001 },
+    { "discovered check",         "8/8/1P2K3/8/2n5/1q6/8/5k2 b - - 0 1", 5, 1004658 },
+    { "promote to give check",    "4k3/1P6/8/8/8/8/K7/8 w - - 0 1", 6, 217342 },
+    { "under-promote to check",   "8/P1k5/K7/8/8/8/8/8 w - - 0 1", 6, 92683 },
+    { "self stalemate",           "K1k5/8/P7/8/8/8/8/8 w - - 0 1", 6, 2217 },
+    { "stalemate and mate 1",     "8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584 },
+    { "stalemate and mate 2",     "8/8/2k5/5q2/5n2/8/5K2/8 b - - 0 1", 4, 23527 },
+};
+
+#define PERFT_SUITE_SIZE (sizeof(perft_suite) / sizeof(perft_suite[0]))
+
+// The keys given by the Polyglot specification, a wrong random number would
+// make every book lookup miss
+static const struct { const char* fen; u64 key; } polyglot_suite[] = {
+    { STARTING_FEN, 0x463B96181691FC9C },
+    { "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823C9B50FD114196 },
+    { "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756B94461C50FB0 },
+    { "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662FAFB965DB29D4 },
+    { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22A48B5A8E47FF78 },
+    { "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652A607CA3F242C1 },
+    { "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00FDD303C946BDD9 },
+    { "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3C8123EA7B067637 },
+    { "rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5C3F9B829B279560 },
+};
+
+#define POLYGLOT_SUITE_SIZE (sizeof(polyglot_suite) / sizeof(polyglot_suite[0]))
+
+// The second game has no tags, it still starts right after the first one's result
+static const char pgn_suite[] =
+    "[Event \"Ruy Lopez\"]\n[Result \"1-0\"]\n\n1. e4 e5 2. Nf3 Nc6 3. Bb5 a6 1-0\n\n"
+    "1. d4 d5 2. c4 e6 3. Nc3 Nf6 1/2-1/2\n\n"
+    "[Event \"Fool's mate\"]\n[Result \"0-1\"]\n\n1. f3 e5 2. g4 Qh4# 0-1\n\n"
+    "[Event \"English\"]\n[Result \"*\"]\n\n1. c4 *\n";
+
+#define PGN_SUITE_GAMES 4
+#define PGN_SUITE_PLIES 17
+
+static u64 perft(GameState* state, u8 depth) {
+    Move moves[MAX_MOVES];
+    const size_t nb_moves = generate_legal_moves(state, moves);
+
+    // Bulk counting: no need to play the last move
+    if (depth == 1) return nb_moves;
+
+    u64 nodes = 0;
+    for (size_t i = 0; i < nb_moves; i++) {
+        make_move(state, moves[i]);
+        nodes += perft(state, depth - 1);
+        unmake_move(state);
+    }
+    return nodes;
+}
+
+static u64 divide(GameState* state, u8 depth) {
+    static const char promotion_chars[] = { [ROOK] = 'r', [KNIGHT] = 'n', [BISHOP] = 'b', [QWEEN] = 'q' };
+    Move moves[MAX_MOVES];
+    const size_t nb_moves = generate_legal_moves(state, moves);
+
+    u64 total_nodes = 0;
+    for (size_t i = 0; i < nb_moves; i++) {
+        make_move(state, moves[i]);
+        const u64 nodes = depth > 1 ? perft(state, depth - 1) : 1;
+        unmake_move(state);
+        total_nodes += nodes;
+
+        char start_str[3], end_str[3];
+        format_square(position_of(moves[i].start), start_str);
+        format_square(position_of(moves[i].end), end_str);
+        if (moves[i].flags & MOVE_PROMOTION)
+            printf("%s%s%c: %lu\n", start_str, end_str, promotion_chars[moves[i].promotion], nodes);
+        else
+            printf("%s%s: %lu\n", start_str, end_str, nodes);
+    }
+
+    printf("\n");
+    return total_nodes;
+}
+
+static f64 now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static size_t check_polyglot_keys(bool verbose) {
+    size_t nb_failed = 0;
+    for (size_t i = 0; i < POLYGLOT_SUITE_SIZE; i++) {
+        GameState state;
+        load_fen(&state, polyglot_suite[i].fen);
+        const u64 key = polyglot_key(&state);
+        const bool ok = key == polyglot_suite[i].key;
+        if (!ok) nb_failed++;
+        if (verbose || !ok) {
+            printf("polyglot key %016lx (expected %016lx) %s\n", key, polyglot_suite[i].key, ok ? "ok" : "FAILED");
+        }
+    }
+    return nb_failed;
+}
+
+static size_t check_pgn_games(bool verbose) {
+    char path[] = "/tmp/perft-pgn-XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0) {
+        printf("pgn games: can't create %s FAILED\n", path);
+        return 1;
+    }
+    const bool written = write(fd, pgn_suite, sizeof(pgn_suite) - 1) == sizeof(pgn_suite) - 1;
+    close(fd);
+
+    PgnStats stats = {0};
+    const bool replayed = written && replay_pgn_file(path, 1, NULL, NULL, &stats);
+    unlink(path);
+
+    const bool ok = replayed && stats.nb_games == PGN_SUITE_GAMES && stats.nb_plies == PGN_SUITE_PLIES
+        && stats.nb_errors == 0 && stats.nb_checkmates == 1;
+    if (verbose || !ok) {
+        printf("pgn games %lu, plies %lu (expected %u, %u) %s\n",
+            stats.nb_games, stats.nb_plies, PGN_SUITE_GAMES, PGN_SUITE_PLIES, ok ? "ok" : "FAILED");
+    }
+    return !ok;
+}
+
+static int run_suite(bool verbose) {
+    u64 total_nodes = 0;
+    f64 total_time = 0.0;
+    size_t nb_failed = check_polyglot_keys(verbose) + check_pgn_games(verbose);
+
+    for (size_t i = 0; i < PERFT_SUITE_SIZE; i++) {
+        const PerftCase* test = &perft_suite[i];
+        GameState state;
+        if (!load_fen(&state, test->fen)) {
+            fprintf(stderr, "invalid FEN in suite: %s\n", test->fen);
+            return 1;
+        }
+
+        const f64 start_time = now_seconds();
+        const u64 nodes = perft(&state, test->depth);
+        const f64 elapsed = now_seconds() - start_time;
+        total_nodes += nodes;
+        total_time += elapsed;
+
+        const bool ok = nodes == test->nodes;
+        if (!ok) nb_failed++;
+        if (verbose || !ok) {
+            printf("%-26s depth %u: %10lu nodes (expected %10lu) %s\n",
+                test->name, test->depth, nodes, test->nodes, ok ? "ok" : "FAILED");
+        }
+    }
+
+    if (nb_failed) printf("%zu/%zu positions FAILED\n", nb_failed, PERFT_SUITE_SIZE + POLYGLOT_SUITE_SIZE + 1);
+
+    // Same nodes every run, so only the time can move the figure
+    printf("nodes: %lu\n", total_nodes);
+    printf("time: %.3fs\n", total_time);
+    printf("nps: %.0f\n", total_nodes / total_time);
+
+    // has_moves_available is what try_play_move spends its time in
+    GameState states[PERFT_SUITE_SIZE];
+    for (size_t i = 0; i < PERFT_SUITE_SIZE; i++) load_fen(&states[i], perft_suite[i].fen);
+
+    const size_t nb_calls = 1000000;
+    size_t nb_with_moves = 0;
+    const f64 start_time = now_seconds();
+    for (size_t i = 0; i < nb_calls; i++) {
+        const GameState* state = &states[i % PERFT_SUITE_SIZE];
+        nb_with_moves += has_moves_available(state, state->color_to_play);
+    }
+    const f64 elapsed = now_seconds() - start_time;
+    printf("has_moves_available: %.0f calls/s\n", nb_calls / elapsed);
+    if (nb_with_moves != nb_calls) printf("has_moves_available: wrong result on %zu calls\n", nb_calls - nb_with_moves);
+
+    // evaluate_batch, on the suite positions repeated over more planes than the caches hold
+    const size_t nb_positions = 1 << 18;
+    u8* squares = malloc(64 * nb_positions);
+    u8* colors_to_play = malloc(nb_positions);
+    i32* scores = malloc(nb_positions * sizeof(i32));
+    if (squares == NULL || colors_to_play == NULL || scores == NULL) {
+        fprintf(stderr, "evaluate_batch: out of memory\n");
+        free(squares);
+        free(colors_to_play);
+        free(scores);
+        return 1;
+    }
+    for (size_t i = 0; i < nb_positions; i++) {
+        set_batch_position(&states[i % PERFT_SUITE_SIZE], squares, colors_to_play, nb_positions, i);
+    }
+
+    evaluate_batch(squares, colors_to_play, nb_positions, scores);  // Faults the pages in
+    const size_t nb_rounds = 16;
+    const f64 batch_start_time = now_seconds();
+    for (size_t round = 0; round < nb_rounds; round++) evaluate_batch(squares, colors_to_play, nb_positions, scores);
+    const f64 batch_elapsed = now_seconds() - batch_start_time;
+    printf("evaluate_batch: %.0f evals/s\n", nb_rounds * nb_positions / batch_elapsed);
+
+    size_t nb_wrong_scores = 0;
+    for (size_t i = 0; i < nb_positions; i++) nb_wrong_scores += scores[i] != evaluate(&states[i % PERFT_SUITE_SIZE]);
+    if (nb_wrong_scores) {
+        printf("evaluate_batch: %zu scores differ from evaluate FAILED\n", nb_wrong_scores);
+        nb_failed++;
+    }
+    free(squares);
+    free(colors_to_play);
+    free(scores);
+
+    if (profile_enabled()) {
+        ProfileSnapshot snapshot;
+        profile_snapshot(&snapshot);
+        profile_log_snapshot(&snapshot);
+    }
+
+    return nb_failed ? 1 : 0;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+        "usage: %s [--divide] <depth> [fen]\n"
+        "       %s --suite\n"
+        "       %s --bench\n",
+        program, program, program);
+}
+
+int main(int argc, char** argv) {
+    if (argc == 2 && !strcmp(argv[1], "--suite")) return run_suite(true);
+    if (argc == 2 && !strcmp(argv[1], "--bench")) return run_suite(false);
+
+    int arg = 1;
+    const bool divide_mode = argc > arg && !strcmp(argv[arg], "--divide");
+    if (divide_mode) arg++;
+
+    if (argc <= arg || argc > arg + 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const int depth = atoi(argv[arg]);
+    const char* fen = argc > arg + 1 ? argv[arg + 1] : STARTING_FEN;
+    if (depth < 1 || depth > 255) {
+        fprintf(stderr, "invalid depth: %s\n", argv[arg]);
+        return 1;
+    }
+
+    GameState state;
+    if (!load_fen(&state, fen)) {
+        fprintf(stderr, "invalid FEN: %s\n", fen);
+        return 1;
+    }
+
+    const f64 start_time = now_seconds();
+    const u64 nodes = divide_mode ? divide(&state, depth) : perft(&state, depth);
+    const f64 elapsed = now_seconds() - start_time;
+
+    printf("nodes: %lu\n", nodes);
+    printf("time: %.3fs\n", elapsed);
+    printf("nps: %.0f\n", nodes / elapsed);
+    return 0;
+}
@@ -0,0 +1,440 @@
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pgn.h"
+#include "fen.h"
+#include "thread_pool.h"
+
+// Games are split between threads by chunks of the file. A chunk owns the
+// games whose tags start inside it.
+#define CHUNK_SIZE (1 << 20)
+
+static const char piece_letters[] = { [ROOK] = 'R', [KNIGHT] = 'N', [BISHOP] = 'B', [QWEEN] = 'Q', [KING] = 'K' };
+
+static bool parse_piece_letter(char c, PiecesType* output) {
+    switch (c) {
+        case 'R': *output = ROOK;   return true;
+        case 'N': *output = KNIGHT; return true;
+        case 'B': *output = BISHOP; return true;
+        case 'Q': *output = QWEEN;  return true;
+        case 'K': *output = KING;   return true;
+        default: return false;
+    }
+}
+
+static inline bool side_to_play_in_check(const GameState* state) {
+    const PieceColor color = state->color_to_play;
+    return attacked_squares(&state->attacks, color ^ 1) & state->bitboards.pieces[color][KING];
+}
+
+bool parse_san(const GameState* state, const char* san, Move* output) {
+    char buffer[MAX_SAN_LENGTH + 4];
+    size_t length = 0;
+    while (san[length] && san[length] != ' ' && length < sizeof(buffer) - 1) {
+        buffer[length] = san[length];
+        length++;
+    }
+
+    // Check, mate and annotation marks
+    while (length && (buffer[length - 1] == '+' || buffer[length - 1] == '#'
+                      || buffer[length - 1] == '!' || buffer[length - 1] == '?')) length--;
+    buffer[length] = '\0';
+    if (length < 2) return false;
+
+    Move moves[MAX_MOVES];
+    const size_t nb_moves = generate_legal_moves(state, moves);
+
+    // Castling, with letters or with zeros
+    const bool is_short_castle = !strcmp(buffer, "O-O") || !strcmp(buffer, "0-0");
+    const bool is_long_castle = !strcmp(buffer, "O-O-O") || !strcmp(buffer, "0-0-0");
+    if (is_short_castle || is_long_castle) {
+        for (size_t i = 0; i < nb_moves; i++) {
+            if (!(moves[i].flags & MOVE_CASTLE)) continue;
+            if (((moves[i].end & 7) < (moves[i].start & 7)) != is_long_castle) continue;
+            *output = moves[i];
+            return true;
+        }
+        return false;
+    }
+
+    const char* str = buffer;
+    const char* str_end = buffer + length;
+
+    PiecesType piece_type = PAWN;
+    if (parse_piece_letter(*str, &piece_type)) str++;
+
+    // "e8=Q", or "e8Q" without the '='
+    PiecesType promotion = PAWN;
+    if (str_end - str > 2 && parse_piece_letter(str_end[-1], &promotion)) {
+        if (promotion == KING) return false;
+        str_end--;
+        if (str_end[-1] == '=') str_end--;
+    }
+
+    Position end;
+    if (str_end - str < 2 || !parse_square(str_end - 2, &end)) return false;
+    str_end -= 2;
+
+    // Whatever is left says where the piece comes from
+    i8 start_col = -1, start_row = -1;
+    for (; str < str_end; str++) {
+        if (*str >= 'a' && *str <= 'h') start_col = *str - 'a';
+        else if (*str >= '1' && *str <= '8') start_row = '8' - *str;
+        else if (*str != 'x' && *str != ':' && *str != '-') return false;
+    }
+
+    size_t nb_matches = 0;
+    for (size_t i = 0; i < nb_moves; i++) {
+        const Move move = moves[i];
+        const Position start = position_of(move.start);
+        if (move.end != square_of(end)) continue;
+        if (state->board[start.row][start.col].type != piece_type) continue;
+        if (start_col >= 0 && start.col != start_col) continue;
+        if (start_row >= 0 && start.row != start_row) continue;
+        if (move.flags & MOVE_PROMOTION) {
+            if (move.promotion != (promotion == PAWN ? QWEEN : promotion)) continue;
+        } else if (promotion != PAWN) {
+            continue;
+        }
+
+        *output = move;
+        nb_matches++;
+    }
+
+    return nb_matches == 1;
+}
+
+size_t format_san(GameState* state, Move move, char* output) {
+    const Position start = position_of(move.start);
+    const Position end = position_of(move.end);
+    const Cell piece = state->board[start.row][start.col];
+    const bool is_capture = !state->board[end.row][end.col].is_empty || (piece.type == PAWN && start.col != end.col);
+    char* out = output;
+
+    if (piece.type == KING && abs(end.col - start.col) == 2) {
+        out += sprintf(out, end.col < start.col ? "O-O-O" : "O-O");
+    } else {
+        if (piece.type == PAWN) {
+            if (is_capture) *out++ = 'a' + start.col;
+        } else {
+            *out++ = piece_letters[piece.type];
+
+            // Only say where the piece comes from when another one could go there too
+            Move moves[MAX_MOVES];
+            const size_t nb_moves = generate_legal_moves(state, moves);
+            bool is_ambiguous = false, same_col = false, same_row = false;
+            for (size_t i = 0; i < nb_moves; i++) {
+                const Position other = position_of(moves[i].start);
+                if (moves[i].end != move.end || moves[i].start == move.start) continue;
+                if (state->board[other.row][other.col].type != piece.type) continue;
+                is_ambiguous = true;
+                same_col |= other.col == start.col;
+                same_row |= other.row == start.row;
+            }
+
+            if (is_ambiguous && (!same_col || same_row)) *out++ = 'a' + start.col;
+            if (is_ambiguous && same_col) *out++ = '8' - start.row;
+        }
+
+        if (is_capture) *out++ = 'x';
+        format_square(end, out);
+        out += 2;
+
+        if (piece.type == PAWN && (end.row == 0 || end.row == 7)) {
+            *out++ = '=';
+            *out++ = piece_letters[move.promotion == PAWN || move.promotion == KING ? QWEEN : move.promotion];
+        }
+    }
+
+    make_move(state, move);
+    if (side_to_play_in_check(state)) *out++ = has_moves_available(state, state->color_to_play) ? '+' : '#';
+    unmake_move(state);
+
+    *out = '\0';
+    return out - output;
+}
+
+static inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+
+static const char* skip_blanks(const char* str, const char* end) {
+    while (str < end && is_blank(*str)) str++;
+    return str;
+}
+
+static const char* skip_line(const char* str, const char* end) {
+    const char* newline = memchr(str, '\n', end - str);
+    return newline ? newline + 1 : end;
+}
+
+static const char* skip_past(const char* str, const char* end, char c) {
+    if (str >= end) return end;
+    const char* found = memchr(str, c, end - str);
+    return found ? found + 1 : end;
+}
+
+// Variations can nest, and hold comments with parentheses in them
+static const char* skip_variation(const char* str, const char* end) {
+    u32 nb_open = 0;
+    while (str < end) {
+        const char c = *str++;
+        if (c == '{') str = skip_past(str, end, '}');
+        else if (c == '(') nb_open++;
+        else if (c == ')' && --nb_open == 0) break;
+    }
+    return str;
+}
+
+static bool parse_result(const char* token, size_t length, GameResult* output) {
+    if (length == 3 && !memcmp(token, "1-0", 3)) *output = RESULT_WHITE_WINS;
+    else if (length == 3 && !memcmp(token, "0-1", 3)) *output = RESULT_BLACK_WINS;
+    else if (length == 7 && !memcmp(token, "1/2-1/2", 7)) *output = RESULT_DRAW;
+    else if (length == 1 && *token == '*') *output = RESULT_UNKNOWN;
+    else return false;
+    return true;
+}
+
+// `[Name "Value"]`, only FEN and Result matter here
+static void parse_tag(const char* str, const char* end, GameResult* result, char* fen) {
+    str++;
+    const char* name = str;
+    while (str < end && !is_blank(*str) && *str != '"') str++;
+    const size_t name_length = str - name;
+
+    str = skip_past(str, end, '"');
+    char value[MAX_FEN_LENGTH];
+    size_t value_length = 0;
+    for (; str < end && *str != '"'; str++) {
+        if (*str == '\\' && str + 1 < end) str++;
+        if (value_length < MAX_FEN_LENGTH - 1) value[value_length++] = *str;
+    }
+    value[value_length] = '\0';
+
+    if (name_length == 3 && !memcmp(name, "FEN", 3)) memcpy(fen, value, value_length + 1);
+    else if (name_length == 6 && !memcmp(name, "Result", 6)) parse_result(value, value_length, result);
+}
+
+size_t replay_pgn_game(GameState* state, const char* pgn, size_t length, PgnGame* output) {
+    const char* str = pgn;
+    const char* end = pgn + length;
+    *output = (PgnGame) {0};
+
+    GameResult tag_result = RESULT_UNKNOWN;
+    char fen[MAX_FEN_LENGTH] = STARTING_FEN;
+
+    str = skip_blanks(str, end);
+    while (str < end && *str == '[') {
+        const char* line_end = skip_line(str, end);
+        parse_tag(str, line_end, &tag_result, fen);
+        str = skip_blanks(line_end, end);
+    }
+
+    // Also rejects FENs that can't be reached, replaying from those can capture a king
+    if (!load_fen(state, fen)) output->error = PGN_INVALID_FEN;
+
+    bool has_result = false;
+    while (str < end) {
+        const char c = *str;
+        if (is_blank(c)) {
+            str++;
+        } else if (c == '[' && (str == pgn || str[-1] == '\n')) {
+            break;  // Tags of the next game, this one had no result
+        } else if (c == '{') {
+            str = skip_past(str + 1, end, '}');
+        } else if (c == ';' || (c == '%' && (str == pgn || str[-1] == '\n'))) {
+            str = skip_line(str, end);
+        } else if (c == '(') {
+            str = skip_variation(str, end);
+        } else if (c == '$') {
+            for (str++; str < end && isdigit(*str); str++);
+        } else {
+            const char* token = str;
+            while (str < end && !is_blank(*str) && !strchr("{}();[$", *str)) str++;
+            if (str == token) {
+                str++;  // A lone ')' or ']' and such
+                continue;
+            }
+
+            if (parse_result(token, str - token, &output->result)) {
+                has_result = true;
+                break;
+            }
+
+            // Move numbers, maybe stuck to the move ("12.e4", "12...Nf6")
+            const char* move = token;
+            while (move < str && isdigit(*move)) move++;
+            if (move < str && *move == '.') {
+                while (move < str && *move == '.') move++;
+            } else {
+                move = token;
+            }
+            if (move == str || output->error != PGN_OK) continue;
+
+            char san[MAX_SAN_LENGTH + 4];
+            const size_t san_length = (size_t) (str - move) < sizeof(san) - 1 ? (size_t) (str - move) : sizeof(san) - 1;
+            memcpy(san, move, san_length);
+            san[san_length] = '\0';
+
+            Move parsed;
+            if (!parse_san(state, san, &parsed)) {
+                output->error = PGN_ILLEGAL_MOVE;
+                output->error_offset = move - pgn;
+                continue;
+            }
+            make_move(state, parsed);
+            output->nb_plies++;
+        }
+    }
+
+    if (!has_result) output->result = tag_result;
+    if (output->error != PGN_INVALID_FEN) {
+        const bool has_moves = has_moves_available(state, state->color_to_play);
+        output->is_check = side_to_play_in_check(state);
+        output->is_checkmate = output->is_check && !has_moves;
+        output->is_stalemate = !output->is_check && !has_moves;
+    }
+
+    output->length = str - pgn;
+    return output->length;
+}
+
+typedef struct {
+    GameState state;  // Reset for every game
+    PgnStats stats;
+} PgnReplayer;
+
+typedef struct {
+    const char* data;
+    size_t size;
+    PgnReplayer* replayers;
+    PgnCallback callback;
+    void* user_data;
+} PgnFile;
+
+// In the middle of the file, a game can only be spotted by the first of its
+// tags, the line before it being blank or not a tag
+static bool is_game_start(const char* data, size_t offset) {
+    if (data[offset] != '[') return false;
+    if (offset == 0) return true;
+    if (data[offset - 1] != '\n') return false;
+
+    size_t line_end = offset - 1;
+    if (line_end > 0 && data[line_end - 1] == '\r') line_end--;
+    size_t line_start = line_end;
+    while (line_start > 0 && data[line_start - 1] != '\n') line_start--;
+    return line_start == line_end || data[line_start] != '[';
+}
+
+static size_t find_game_start(const PgnFile* file, size_t offset) {
+    while (offset < file->size && !is_game_start(file->data, offset)) {
+        const char* newline = memchr(file->data + offset, '\n', file->size - offset);
+        if (newline == NULL) return file->size;
+        offset = newline - file->data + 1;
+    }
+    return offset;
+}
+
+// Right after a game's result, whatever isn't blank is the next game
+static size_t next_game(const PgnFile* file, size_t offset) {
+    while (offset < file->size && is_blank(file->data[offset])) offset++;
+    return offset;
+}
+
+static void replay_chunk(void* context, u16 thread_index, size_t chunk) {
+    const PgnFile* file = context;
+    PgnReplayer* replayer = &file->replayers[thread_index];
+    const size_t start = chunk * CHUNK_SIZE;
+    const size_t end = start + CHUNK_SIZE < file->size ? start + CHUNK_SIZE : file->size;
+
+    // Games follow each other from their first byte, tags or not, but a chunk
+    // can only guess where one starts from its tags. So a chunk goes on until
+    // the start of the next one, and tagless games in between stay with it.
+    size_t offset = chunk == 0 ? next_game(file, 0) : find_game_start(file, start);
+    const size_t next_chunk_start = find_game_start(file, end);
+    while (offset < next_chunk_start) {
+        PgnGame game;
+        const size_t length = replay_pgn_game(&replayer->state, file->data + offset, file->size - offset, &game);
+        game.offset = offset;
+
+        PgnStats* stats = &replayer->stats;
+        stats->nb_games++;
+        stats->nb_plies += game.nb_plies;
+        stats->nb_errors += game.error != PGN_OK;
+        stats->nb_checkmates += game.is_checkmate;
+        stats->nb_stalemates += game.is_stalemate;
+        // The state wasn't touched by a game with a bad FEN, it holds whatever came before
+        const GameState* final_state = game.error == PGN_INVALID_FEN ? NULL : &replayer->state;
+        if (file->callback) file->callback(file->user_data, thread_index, &game, final_state);
+
+        offset = next_game(file, offset + (length ? length : 1));
+    }
+}
+
+static f64 now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+bool replay_pgn_file(const char* path, u16 nb_threads, PgnCallback callback, void* user_data, PgnStats* stats) {
+    *stats = (PgnStats) {0};
+    const f64 start_time = now_seconds();
+
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return false;
+    }
+    if (file_stat.st_size == 0) {
+        close(fd);
+        return true;
+    }
+
+    const size_t size = file_stat.st_size;
+    const char* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    madvise((void*) data, size, MADV_SEQUENTIAL);
+
+    if (nb_threads == 0) nb_threads = default_thread_count();
+    if (nb_threads > MAX_POOL_THREADS) nb_threads = MAX_POOL_THREADS;
+    PgnFile file = {
+        .data = data,
+        .size = size,
+        .replayers = malloc(nb_threads * sizeof(PgnReplayer)),
+        .callback = callback,
+        .user_data = user_data,
+    };
+    if (file.replayers == NULL) {
+        munmap((void*) data, size);
+        return false;
+    }
+    for (u16 i = 0; i < nb_threads; i++) file.replayers[i].stats = (PgnStats) {0};
+
+    parallel_for((size + CHUNK_SIZE - 1) / CHUNK_SIZE, nb_threads, replay_chunk, &file);
+
+    for (u16 i = 0; i < nb_threads; i++) {
+        const PgnStats* replayer_stats = &file.replayers[i].stats;
+        stats->nb_games += replayer_stats->nb_games;
+        stats->nb_plies += replayer_stats->nb_plies;
+        stats->nb_errors += replayer_stats->nb_errors;
+        stats->nb_checkmates += replayer_stats->nb_checkmates;
+        stats->nb_stalemates += replayer_stats->nb_stalemates;
+    }
+
+    free(file.replayers);
+    munmap((void*) data, size);
+
+    stats->elapsed_seconds = now_seconds() - start_time;
+    stats->games_per_second = stats->nb_games / stats->elapsed_seconds;
+    return true;
+}
@@ -0,0 +1,56 @@
+// vim:ft=c
+#pragma once
+
+#include "lib.h"
+
+// "Nbxd7=Q+" and such, with room for the final NUL
+#define MAX_SAN_LENGTH 12
+
+typedef enum: u8 { RESULT_UNKNOWN, RESULT_WHITE_WINS, RESULT_BLACK_WINS, RESULT_DRAW } GameResult;
+
+typedef enum: u8 { PGN_OK, PGN_ILLEGAL_MOVE, PGN_INVALID_FEN } PgnError;
+
+typedef struct {
+    u64 offset;  // Of the game in the file, tags included
+    u64 length;
+    GameResult result;  // From the movetext, or the Result tag without one
+    u16 nb_plies;       // Stops at the illegal move, if any
+
+    PgnError error;
+    u64 error_offset;  // Of the move that couldn't be played
+
+    bool is_check;
+    bool is_checkmate;
+    bool is_stalemate;
+} PgnGame;
+
+typedef struct {
+    u64 nb_games;
+    u64 nb_plies;
+    u64 nb_errors;
+    u64 nb_checkmates;
+    u64 nb_stalemates;
+    f64 elapsed_seconds;
+    f64 games_per_second;
+} PgnStats;
+
+// Called once per game, from the replaying threads. `state` is the final
+// position, only valid during the call, and NULL if the game's FEN is invalid.
+typedef void (*PgnCallback)(void* user_data, u16 thread_index, const PgnGame* game, const GameState* state);
+
+// SAN is resolved against the legal moves, so a move that is ambiguous or
+// can't be played is an error. `san` stops at the first space or NUL.
+bool parse_san(const GameState* state, const char* san, Move* output);
+
+// The move is played then taken back to know if it checks or mates.
+// Returns the SAN's length.
+size_t format_san(GameState* state, Move move, char* output);
+
+// Replays one game from `pgn` (not NUL terminated) into `state`, which is reset
+// first, or left untouched if the game's FEN is invalid. Returns how many bytes
+// the game took.
+size_t replay_pgn_game(GameState* state, const char* pgn, size_t length, PgnGame* output);
+
+// Maps the file and replays all its games on `nb_threads` threads (0 for one
+// per core). Returns false if the file can't be read.
+bool replay_pgn_file(const char* path, u16 nb_threads, PgnCallback callback, void* user_data, PgnStats* stats);
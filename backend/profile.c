@@ -0,0 +1,190 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profile.h"
+
+static const char* point_names[PROFILE_POINT_COUNT] = {
+    [PROFILE_GET_POSSIBLE_MOVES]  = "get_possible_moves",
+    [PROFILE_GET_MOVES_PAWN]      = "get_possible_moves_pawn",
+    [PROFILE_GET_MOVES_ROOK]      = "get_possible_moves_rook",
+    [PROFILE_GET_MOVES_KNIGHT]    = "get_possible_moves_knight",
+    [PROFILE_GET_MOVES_BISHOP]    = "get_possible_moves_bishop",
+    [PROFILE_GET_MOVES_QWEEN]     = "get_possible_moves_qween",
+    [PROFILE_GET_MOVES_KING]      = "get_possible_moves_king",
+    [PROFILE_IS_IN_CHECK]         = "is_in_check",
+    [PROFILE_FIND_CELL]           = "find_cell",
+    [PROFILE_HAS_MOVES_AVAILABLE] = "has_moves_available",
+    [PROFILE_TRY_PLAY_MOVE]       = "try_play_move",
+};
+
+const char* profile_point_name(ProfilePoint point) {
+    return point < PROFILE_POINT_COUNT ? point_names[point] : "unknown";
+}
+
+#ifdef CHESS_PROFILE
+
+static f64 now_seconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+#if !defined(__x86_64__) && !defined(__i386__)
+u64 profile_ticks(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (u64) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+#endif
+
+// Blocks of exited threads are given to the next ones, their counts stay
+#define MAX_PROFILED_THREADS 1024
+
+typedef struct {
+    ProfileCounters points[PROFILE_POINT_COUNT];
+} ThreadCounters;
+
+_Thread_local ProfileCounters* profile_thread_counters = NULL;
+
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t registry_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_exit_key;
+static ThreadCounters* thread_blocks[MAX_PROFILED_THREADS];
+static bool block_in_use[MAX_PROFILED_THREADS];
+static u16 nb_thread_blocks = 0;
+static ProfileSnapshot baseline;  // What `profile_reset` subtracts
+
+static void release_block(void* block) {
+    pthread_mutex_lock(&registry_lock);
+    for (u16 i = 0; i < nb_thread_blocks; i++)
+        if (thread_blocks[i] == block) block_in_use[i] = false;
+    pthread_mutex_unlock(&registry_lock);
+}
+
+static void create_exit_key(void) {
+    pthread_key_create(&thread_exit_key, release_block);
+}
+
+// NULL past MAX_PROFILED_THREADS live threads, their calls aren't counted
+ProfileCounters* profile_register_thread(void) {
+    pthread_once(&registry_once, create_exit_key);
+    ThreadCounters* block = NULL;
+
+    pthread_mutex_lock(&registry_lock);
+    for (u16 i = 0; i < nb_thread_blocks && block == NULL; i++) {
+        if (!block_in_use[i]) {
+            block_in_use[i] = true;
+            block = thread_blocks[i];
+        }
+    }
+    if (block == NULL && nb_thread_blocks < MAX_PROFILED_THREADS) {
+        block = calloc(1, sizeof(ThreadCounters));
+        if (block != NULL) {
+            block_in_use[nb_thread_blocks] = true;
+            thread_blocks[nb_thread_blocks++] = block;
+        }
+    }
+    pthread_mutex_unlock(&registry_lock);
+
+    if (block == NULL) return NULL;
+    pthread_setspecific(thread_exit_key, block);
+    profile_thread_counters = block->points;
+    return profile_thread_counters;
+}
+
+// Measured once against the monotonic clock
+static f64 ticks_per_second(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    static f64 measured = 0.0;
+    if (measured == 0.0) {
+        const f64 start_time = now_seconds();
+        const u64 start_ticks = profile_ticks();
+        while (now_seconds() - start_time < 0.01) {}
+        measured = (profile_ticks() - start_ticks) / (now_seconds() - start_time);
+    }
+    return measured;
+#else
+    return 1e9;
+#endif
+}
+
+static void sum_blocks(ProfileSnapshot* output) {
+    memset(output, 0, sizeof(ProfileSnapshot));
+    for (u16 i = 0; i < nb_thread_blocks; i++) {
+        for (size_t point = 0; point < PROFILE_POINT_COUNT; point++) {
+            const ProfileCounters* counters = &thread_blocks[i]->points[point];
+            ProfileCounters* sum = &output->points[point];
+            sum->nb_calls += __atomic_load_n(&counters->nb_calls, __ATOMIC_RELAXED);
+            sum->total_ticks += __atomic_load_n(&counters->total_ticks, __ATOMIC_RELAXED);
+            for (size_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++)
+                sum->histogram[bucket] += __atomic_load_n(&counters->histogram[bucket], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+bool profile_enabled(void) { return true; }
+
+void profile_snapshot(ProfileSnapshot* output) {
+    pthread_mutex_lock(&registry_lock);
+    sum_blocks(output);
+    for (size_t point = 0; point < PROFILE_POINT_COUNT; point++) {
+        ProfileCounters* counters = &output->points[point];
+        const ProfileCounters* base = &baseline.points[point];
+        counters->nb_calls -= base->nb_calls;
+        counters->total_ticks -= base->total_ticks;
+        for (size_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++) counters->histogram[bucket] -= base->histogram[bucket];
+    }
+    pthread_mutex_unlock(&registry_lock);
+    output->ticks_per_second = ticks_per_second();
+}
+
+// The counters belong to their threads, resetting only moves the baseline
+void profile_reset(void) {
+    pthread_mutex_lock(&registry_lock);
+    sum_blocks(&baseline);
+    pthread_mutex_unlock(&registry_lock);
+}
+
+#else
+
+bool profile_enabled(void) { return false; }
+
+void profile_snapshot(ProfileSnapshot* output) {
+    memset(output, 0, sizeof(ProfileSnapshot));
+}
+
+void profile_reset(void) {}
+
+#endif
+
+// One line per point that was called, with the average and approximate percentiles
+void profile_log_snapshot(const ProfileSnapshot* snapshot) {
+    const f64 ns_per_tick = snapshot->ticks_per_second > 0.0 ? 1e9 / snapshot->ticks_per_second : 0.0;
+    printf("%-26s %12s %10s %10s %10s %10s\n", "", "calls", "total ms", "avg ns", "p50 ns", "p99 ns");
+
+    for (size_t point = 0; point < PROFILE_POINT_COUNT; point++) {
+        const ProfileCounters* counters = &snapshot->points[point];
+        if (counters->nb_calls == 0) continue;
+
+        // Upper bound of the bucket the percentile falls in
+        f64 percentiles[2] = {0};
+        const f64 ranks[2] = { 0.5, 0.99 };
+        for (size_t i = 0; i < 2; i++) {
+            u64 seen = 0;
+            for (size_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+                seen += counters->histogram[bucket];
+                if (seen >= ranks[i] * counters->nb_calls) {
+                    percentiles[i] = (f64) (1ull << bucket) * ns_per_tick;
+                    break;
+                }
+            }
+        }
+
+        printf("%-26s %12lu %10.1f %10.1f %10.0f %10.0f\n", point_names[point], counters->nb_calls,
+            counters->total_ticks * ns_per_tick * 1e-6, (f64) counters->total_ticks / counters->nb_calls * ns_per_tick,
+            percentiles[0], percentiles[1]);
+    }
+}
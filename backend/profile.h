@@ -0,0 +1,86 @@
+// vim:ft=c
+#pragma once
+
+#include "common_types.h"
+
+// Call counts, time and latency histograms around the hot calls of the
+// library. Only compiled in with CHESS_PROFILE defined (`make PROFILE=1`),
+// otherwise the macros are empty and snapshots stay zeroed.
+typedef enum: u8 {
+    PROFILE_GET_POSSIBLE_MOVES,
+    PROFILE_GET_MOVES_PAWN,  // Then one per PiecesType, in the same order
+    PROFILE_GET_MOVES_ROOK,
+    PROFILE_GET_MOVES_KNIGHT,
+    PROFILE_GET_MOVES_BISHOP,
+    PROFILE_GET_MOVES_QWEEN,
+    PROFILE_GET_MOVES_KING,
+    PROFILE_IS_IN_CHECK,
+    PROFILE_FIND_CELL,
+    PROFILE_HAS_MOVES_AVAILABLE,
+    PROFILE_TRY_PLAY_MOVE,
+    PROFILE_POINT_COUNT,
+} ProfilePoint;
+
+// Bucket `i` counts the calls that took [2^(i-1), 2^i) ticks, the last one
+// everything above
+#define PROFILE_BUCKETS 32
+
+typedef struct {
+    u64 nb_calls;
+    u64 total_ticks;
+    u64 histogram[PROFILE_BUCKETS];
+} ProfileCounters;
+
+typedef struct {
+    ProfileCounters points[PROFILE_POINT_COUNT];
+    f64 ticks_per_second;
+} ProfileSnapshot;
+
+bool profile_enabled(void);
+const char* profile_point_name(ProfilePoint point);
+
+// Sums all threads, including the ones that exited, since the last reset.
+// Can be called from any thread while the others keep counting.
+void profile_snapshot(ProfileSnapshot* output);
+void profile_reset(void);
+void profile_log_snapshot(const ProfileSnapshot* snapshot);
+
+#ifdef CHESS_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline u64 profile_ticks(void) { return __rdtsc(); }
+#else
+u64 profile_ticks(void);  // Nanoseconds
+#endif
+
+// Each thread counts in its own block, registered on its first call
+extern _Thread_local ProfileCounters* profile_thread_counters;
+ProfileCounters* profile_register_thread(void);
+
+static inline void profile_bump(u64* counter, u64 value) {
+    // Only this thread writes, the atomics are for the snapshots
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+static inline void profile_record(ProfilePoint point, u64 ticks) {
+    ProfileCounters* counters = profile_thread_counters;
+    if (counters == NULL) counters = profile_register_thread();
+    if (counters == NULL) return;
+
+    const u8 bucket = ticks ? 64 - __builtin_clzll(ticks) : 0;
+    profile_bump(&counters[point].nb_calls, 1);
+    profile_bump(&counters[point].total_ticks, ticks);
+    profile_bump(&counters[point].histogram[bucket < PROFILE_BUCKETS ? bucket : PROFILE_BUCKETS - 1], 1);
+}
+
+// `timer` is any name, unique in its scope
+#define PROFILE_BEGIN(timer) const u64 profile_start_##timer = profile_ticks()
+#define PROFILE_END(timer, point) profile_record(point, profile_ticks() - profile_start_##timer)
+
+#else
+
+#define PROFILE_BEGIN(timer) ((void) 0)
+#define PROFILE_END(timer, point) ((void) 0)
+
+#endif
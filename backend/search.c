@@ -0,0 +1,487 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "search.h"
+#include "eval.h"
+
+#define INFINITE_SCORE (MATE_SCORE + 1)
+
+// Stop checks are not free, only look at the clock every so often
+#define NODES_BETWEEN_CHECKS 1024
+
+#define MAX_HISTORY 16384
+
+typedef struct SearchThread SearchThread;
+
+struct SearchThread {
+    Searcher* searcher;
+    const SearchLimits* limits;
+    SearchThread* threads;  // All of them, for the node limit
+    u16 index;              // 0 is the main thread
+    GameState state;        // Played into and taken back by the search
+
+    u64 start_ms;
+    u64 optimum_ms;  // Don't start a new iteration past half of it
+    u64 maximum_ms;  // Stop right away past it
+    bool can_stop;   // Not before the first iteration is done, we need a move
+    bool stopped;
+
+    u64 nodes;  // Read by the main thread, only touched atomically
+    Move killers[MAX_PLY][2];
+    i32 history[2][64][64];  // [PieceColor][start][end], for quiet moves
+
+    // Triangular table, `pv[ply]` is the best line found from `ply`
+    Move pv[MAX_PLY][MAX_PLY];
+    u8 pv_length[MAX_PLY];
+};
+
+// Order in which pieces are worth taking, or worth taking with
+static const u8 mvv_lva_rank[6] = {
+    [PAWN] = 1, [KNIGHT] = 2, [BISHOP] = 3, [ROOK] = 4, [QWEEN] = 5, [KING] = 6,
+};
+
+static u64 now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000ull + now.tv_nsec / 1000000;
+}
+
+static inline bool same_move(Move a, Move b) {
+    return a.start == b.start && a.end == b.end && a.promotion == b.promotion;
+}
+
+static inline bool is_quiet(Move move) { return !(move.flags & (MOVE_CAPTURE | MOVE_PROMOTION)); }
+
+static inline bool side_to_play_in_check(const GameState* state) {
+    const PieceColor color = state->color_to_play;
+    return attacked_squares(&state->attacks, color ^ 1) & state->bitboards.pieces[color][KING];
+}
+
+// Mate scores are stored relative to the node, not the root, so they stay
+// right when the position shows up at another ply.
+static inline i32 score_to_tt(i32 score, u8 ply) {
+    if (score >= MATE_BOUND) return score + ply;
+    if (score <= -MATE_BOUND) return score - ply;
+    return score;
+}
+
+static inline i32 score_from_tt(i32 score, u8 ply) {
+    if (score >= MATE_BOUND) return score - ply;
+    if (score <= -MATE_BOUND) return score + ply;
+    return score;
+}
+
+static void set_time_budget(SearchThread* thread) {
+    const SearchLimits* limits = thread->limits;
+    const PieceColor color = thread->state.color_to_play;
+    thread->optimum_ms = UINT64_MAX;
+    thread->maximum_ms = UINT64_MAX;
+
+    if (limits->move_time_ms) {
+        thread->maximum_ms = limits->move_time_ms;
+    } else if (limits->time_left_ms[color]) {
+        // Keep a little for the time it takes to actually play the move
+        const u64 time_left = limits->time_left_ms[color] > 50 ? limits->time_left_ms[color] - 50 : 1;
+        const u64 nb_moves = limits->moves_to_go && limits->moves_to_go < 30 ? limits->moves_to_go : 30;
+
+        thread->optimum_ms = time_left / nb_moves + limits->increment_ms[color] * 3 / 4;
+        thread->maximum_ms = thread->optimum_ms * 4;
+        if (thread->maximum_ms > time_left / 2) thread->maximum_ms = time_left / 2;
+        if (thread->optimum_ms > thread->maximum_ms) thread->optimum_ms = thread->maximum_ms;
+    }
+}
+
+static inline void count_node(SearchThread* thread) {
+    __atomic_store_n(&thread->nodes, thread->nodes + 1, __ATOMIC_RELAXED);
+}
+
+static u64 total_nodes(const SearchThread* threads, u16 nb_threads) {
+    u64 nodes = 0;
+    for (u16 i = 0; i < nb_threads; i++) nodes += __atomic_load_n(&threads[i].nodes, __ATOMIC_RELAXED);
+    return nodes;
+}
+
+static inline bool is_stopped(const Searcher* searcher) {
+    return __atomic_load_n(&searcher->stop, __ATOMIC_RELAXED);
+}
+
+// What counts against the time limits. Pondering is free, the clock starts
+// at the ponderhit.
+static u64 clock_elapsed_ms(const SearchThread* thread) {
+    const SearchLimits* limits = thread->limits;
+    if (__atomic_load_n(&limits->ponder, __ATOMIC_ACQUIRE)) return 0;
+    const u64 ponderhit_ms = __atomic_load_n(&limits->ponderhit_ms, __ATOMIC_RELAXED);
+    return now_ms() - (ponderhit_ms ? ponderhit_ms : thread->start_ms);
+}
+
+// Only the main thread looks at the limits, and stops everyone else when one
+// of them is reached. The node limit is only checked every so often too.
+static bool should_stop(SearchThread* thread) {
+    if (!thread->can_stop) return false;
+    if (is_stopped(thread->searcher)) return true;
+    if (thread->index != 0 || thread->nodes % NODES_BETWEEN_CHECKS != 0) return false;
+
+    const SearchLimits* limits = thread->limits;
+    if ((limits->nodes && total_nodes(thread->threads, thread->searcher->nb_threads) >= limits->nodes)
+            || clock_elapsed_ms(thread) >= thread->maximum_ms) {
+        search_stop(thread->searcher);
+        return true;
+    }
+    return false;
+}
+
+static i32 score_move(const SearchThread* thread, Move move, Move tt_move, u8 ply) {
+    if (same_move(move, tt_move)) return 1 << 30;
+
+    const ChessBoard* board = &thread->state.board;
+    if (move.flags & MOVE_CAPTURE) {
+        const PiecesType victim = move.flags & MOVE_EN_PASSANT ? PAWN : (*board)[move.end >> 3][move.end & 7].type;
+        const PiecesType attacker = (*board)[move.start >> 3][move.start & 7].type;
+        const i32 promotion = move.flags & MOVE_PROMOTION ? piece_values[move.promotion] : 0;
+        return (1 << 24) + promotion + mvv_lva_rank[victim] * 8 - mvv_lva_rank[attacker];
+    }
+
+    if (move.flags & MOVE_PROMOTION)
+        return move.promotion == QWEEN ? (1 << 24) + piece_values[QWEEN] : -(1 << 20);
+
+    if (same_move(move, thread->killers[ply][0])) return (1 << 22) + 1;
+    if (same_move(move, thread->killers[ply][1])) return 1 << 22;
+    return thread->history[thread->state.color_to_play][move.start][move.end];
+}
+
+// Selection sort, one step at a time: after a cutoff the rest is never sorted
+static Move pick_next_move(Move* moves, i32* scores, size_t nb_moves, size_t index) {
+    size_t best = index;
+    for (size_t i = index + 1; i < nb_moves; i++)
+        if (scores[i] > scores[best]) best = i;
+
+    const Move move = moves[best];
+    const i32 score = scores[best];
+    moves[best] = moves[index];
+    scores[best] = scores[index];
+    moves[index] = move;
+    scores[index] = score;
+    return move;
+}
+
+static void update_quiet_stats(SearchThread* thread, Move move, u8 ply, i32 depth) {
+    if (!same_move(move, thread->killers[ply][0])) {
+        thread->killers[ply][1] = thread->killers[ply][0];
+        thread->killers[ply][0] = move;
+    }
+
+    // Saturates at MAX_HISTORY instead of growing forever
+    i32* history = &thread->history[thread->state.color_to_play][move.start][move.end];
+    const i32 bonus = depth * depth < MAX_HISTORY ? depth * depth : MAX_HISTORY;
+    *history += bonus - *history * bonus / MAX_HISTORY;
+}
+
+static void update_pv(SearchThread* thread, Move move, u8 ply) {
+    thread->pv[ply][0] = move;
+    memcpy(&thread->pv[ply][1], thread->pv[ply + 1], thread->pv_length[ply + 1] * sizeof(Move));
+    thread->pv_length[ply] = thread->pv_length[ply + 1] + 1;
+}
+
+// Only captures and qween promotions, so that the evaluation is never taken in
+// the middle of an exchange.
+static i32 quiescence(SearchThread* thread, i32 alpha, i32 beta, u8 ply) {
+    GameState* state = &thread->state;
+    thread->pv_length[ply] = 0;
+    count_node(thread);
+    if (should_stop(thread)) {
+        thread->stopped = true;
+        return 0;
+    }
+
+    const bool in_check = side_to_play_in_check(state);
+    i32 stand_pat = -INFINITE_SCORE;
+    if (!in_check) {
+        stand_pat = evaluate(state);
+        if (stand_pat >= beta || ply >= MAX_PLY - 1) return stand_pat;
+        if (stand_pat > alpha) alpha = stand_pat;
+    }
+
+    Move moves[MAX_MOVES];
+    i32 scores[MAX_MOVES];
+    const size_t nb_generated = generate_legal_moves(state, moves);
+    if (nb_generated == 0) return in_check ? -MATE_SCORE + ply : 0;
+    if (in_check && ply >= MAX_PLY - 1) return evaluate(state);
+
+    // In check every evasion counts, standing pat isn't an option
+    size_t nb_moves = 0;
+    for (size_t i = 0; i < nb_generated; i++) {
+        const Move move = moves[i];
+        if (!in_check && !(move.flags & MOVE_CAPTURE) && !(move.flags & MOVE_PROMOTION && move.promotion == QWEEN)) continue;
+        moves[nb_moves] = move;
+        scores[nb_moves++] = score_move(thread, move, (Move) {0}, ply);
+    }
+
+    i32 best_score = stand_pat;
+    for (size_t i = 0; i < nb_moves; i++) {
+        const Move move = pick_next_move(moves, scores, nb_moves, i);
+
+        make_move(state, move);
+        const i32 score = -quiescence(thread, -beta, -alpha, ply + 1);
+        unmake_move(state);
+        if (thread->stopped) return 0;
+
+        if (score > best_score) {
+            best_score = score;
+            if (score > alpha) {
+                alpha = score;
+                update_pv(thread, move, ply);
+                if (alpha >= beta) break;
+            }
+        }
+    }
+
+    return best_score;
+}
+
+static i32 negamax(SearchThread* thread, i32 alpha, i32 beta, i32 depth, u8 ply) {
+    GameState* state = &thread->state;
+    TranspositionTable* tt = thread->searcher->tt;
+    const bool is_pv_node = beta - alpha > 1;
+    thread->pv_length[ply] = 0;
+
+    if (depth <= 0) return quiescence(thread, alpha, beta, ply);
+
+    count_node(thread);
+    if (should_stop(thread)) {
+        thread->stopped = true;
+        return 0;
+    }
+
+    if (ply > 0) {
+        if (state->halfmove_clock >= 100 || count_repetitions(state)) return 0;
+        if (ply >= MAX_PLY - 1) return evaluate(state);
+
+        // Exact, no need to look further
+        TbResult tb_result;
+        const Tablebases* tablebases = thread->searcher->tablebases;
+        if (tablebases && popcount(state->bitboards.occupied) <= TB_MAX_PIECES
+                && tablebases_probe(tablebases, state, &tb_result)) {
+            if (tb_result.wdl == TB_DRAW) return 0;
+            const i32 mate_score = ply + tb_result.dtm < MAX_PLY ? MATE_SCORE - ply - tb_result.dtm : MATE_BOUND - 1;
+            return tb_result.wdl == TB_WIN ? mate_score : -mate_score;
+        }
+    }
+
+    Move tt_move = {0};
+    TTData tt_data;
+    if (tt_probe(tt, state->hash, &tt_data)) {
+        tt_move = tt_data.move;
+        const i32 tt_score = score_from_tt(tt_data.score, ply);
+        if (!is_pv_node && ply > 0 && tt_data.depth >= depth) {
+            if (tt_data.bound == BOUND_EXACT) return tt_score;
+            if (tt_data.bound == BOUND_LOWER && tt_score >= beta) return tt_score;
+            if (tt_data.bound == BOUND_UPPER && tt_score <= alpha) return tt_score;
+        }
+    }
+
+    const bool in_check = side_to_play_in_check(state);
+    if (in_check) depth++;
+
+    Move moves[MAX_MOVES];
+    i32 scores[MAX_MOVES];
+    const size_t nb_moves = generate_legal_moves(state, moves);
+    if (nb_moves == 0) return in_check ? -MATE_SCORE + ply : 0;
+    for (size_t i = 0; i < nb_moves; i++) scores[i] = score_move(thread, moves[i], tt_move, ply);
+
+    const i32 original_alpha = alpha;
+    i32 best_score = -INFINITE_SCORE;
+    Move best_move = {0};
+
+    for (size_t i = 0; i < nb_moves; i++) {
+        const Move move = pick_next_move(moves, scores, nb_moves, i);
+
+        make_move(state, move);
+        tt_prefetch(tt, state->hash);
+
+        i32 score;
+        if (i == 0) {
+            score = -negamax(thread, -beta, -alpha, depth - 1, ply + 1);
+        } else {
+            // Late quiet moves are unlikely to be any good, look at them less
+            // deep first and only search them fully if they turn out to be.
+            i32 reduction = 0;
+            if (depth >= 3 && i >= 3 && is_quiet(move) && !in_check)
+                reduction = i >= 8 ? 2 : 1;
+
+            score = -negamax(thread, -alpha - 1, -alpha, depth - 1 - reduction, ply + 1);
+            if (score > alpha && reduction)
+                score = -negamax(thread, -alpha - 1, -alpha, depth - 1, ply + 1);
+            if (score > alpha && score < beta)
+                score = -negamax(thread, -beta, -alpha, depth - 1, ply + 1);
+        }
+
+        unmake_move(state);
+        if (thread->stopped) return 0;
+
+        if (score > best_score) {
+            best_score = score;
+            best_move = move;
+            if (score > alpha) {
+                alpha = score;
+                update_pv(thread, move, ply);
+                if (alpha >= beta) {
+                    if (is_quiet(move)) update_quiet_stats(thread, move, ply, depth);
+                    break;
+                }
+            }
+        }
+    }
+
+    const Bound bound = best_score >= beta ? BOUND_LOWER : best_score > original_alpha ? BOUND_EXACT : BOUND_UPPER;
+    tt_store(tt, state->hash, (TTData) {
+        .move = best_move,
+        .score = score_to_tt(best_score, ply),
+        .depth = depth,
+        .bound = bound,
+    });
+
+    return best_score;
+}
+
+Searcher* searcher_create(size_t hash_mb) {
+    Searcher* searcher = malloc(sizeof(Searcher));
+    if (searcher == NULL) return NULL;
+
+    *searcher = (Searcher) { .tt = tt_create(hash_mb), .nb_threads = 1 };
+    if (searcher->tt == NULL) {
+        free(searcher);
+        return NULL;
+    }
+
+    return searcher;
+}
+
+void searcher_destroy(Searcher* searcher) {
+    if (searcher == NULL) return;
+    tt_destroy(searcher->tt);
+    free(searcher);
+}
+
+void searcher_new_game(Searcher* searcher) {
+    tt_clear(searcher->tt);
+}
+
+void searcher_set_threads(Searcher* searcher, u16 nb_threads) {
+    if (nb_threads < 1) nb_threads = 1;
+    if (nb_threads > MAX_SEARCH_THREADS) nb_threads = MAX_SEARCH_THREADS;
+    searcher->nb_threads = nb_threads;
+}
+
+void searcher_set_tablebases(Searcher* searcher, const Tablebases* tablebases) {
+    searcher->tablebases = tablebases;
+}
+
+void searcher_set_network(Searcher* searcher, const NnueNetwork* network) {
+    searcher->network = network;
+}
+
+void searcher_set_info_callback(Searcher* searcher, SearchInfoCallback callback, void* context) {
+    searcher->info_callback = callback;
+    searcher->info_context = context;
+}
+
+void search_stop(Searcher* searcher) {
+    __atomic_store_n(&searcher->stop, true, __ATOMIC_RELAXED);
+}
+
+void search_clear_stop(Searcher* searcher) {
+    __atomic_store_n(&searcher->stop, false, __ATOMIC_RELAXED);
+}
+
+void search_ponderhit(SearchLimits* limits) {
+    __atomic_store_n(&limits->ponderhit_ms, now_ms(), __ATOMIC_RELAXED);
+    __atomic_store_n(&limits->ponder, false, __ATOMIC_RELEASE);
+}
+
+static void iterative_deepening(SearchThread* thread, SearchResult* output) {
+    const SearchLimits* limits = thread->limits;
+    const u8 max_depth = limits->depth && limits->depth < MAX_PLY ? limits->depth : MAX_PLY - 1;
+
+    // Helpers on odd indices start one ply deeper, so that threads don't all
+    // search the same depth at the same time.
+    const u8 first_depth = thread->index & 1 ? 2 : 1;
+    for (u8 depth = first_depth; depth <= max_depth; depth++) {
+        const i32 score = negamax(thread, -INFINITE_SCORE, INFINITE_SCORE, depth, 0);
+        if (thread->stopped) break;
+        thread->can_stop = true;
+        if (output == NULL) continue;
+
+        output->score = score;
+        output->depth = depth;
+        output->pv_length = thread->pv_length[0];
+        memcpy(output->pv, thread->pv[0], thread->pv_length[0] * sizeof(Move));
+        if (output->pv_length) output->best_move = output->pv[0];
+
+        const Searcher* searcher = thread->searcher;
+        if (searcher->info_callback) {
+            output->nodes = total_nodes(thread->threads, searcher->nb_threads);
+            output->elapsed_ms = now_ms() - thread->start_ms;
+            searcher->info_callback(output, searcher->info_context);
+        }
+
+        // A mate this close won't get any better
+        if (score >= MATE_BOUND && MATE_SCORE - score <= depth) break;
+        if (score <= -MATE_BOUND && MATE_SCORE + score <= depth) break;
+
+        // The next iteration takes longer than all the previous ones together
+        const u64 elapsed = clock_elapsed_ms(thread);
+        if (thread->optimum_ms != UINT64_MAX && elapsed >= thread->optimum_ms / 2) break;
+        if (elapsed >= thread->maximum_ms) break;
+        if (limits->nodes && total_nodes(thread->threads, thread->searcher->nb_threads) >= limits->nodes) break;
+        if (is_stopped(thread->searcher)) break;
+    }
+}
+
+static void* helper_thread_main(void* arg) {
+    iterative_deepening(arg, NULL);
+    return NULL;
+}
+
+void search_best_move(Searcher* searcher, const GameState* state, const SearchLimits* limits, SearchResult* output) {
+    const u16 nb_threads = searcher->nb_threads;
+    *output = (SearchResult) { .nb_threads = nb_threads };
+
+    // Too big for the stack with the history and PV tables
+    SearchThread* threads = calloc(nb_threads, sizeof(SearchThread));
+    if (threads == NULL) return;
+
+    const u64 start_ms = now_ms();
+    tt_new_search(searcher->tt);
+
+    for (u16 i = 0; i < nb_threads; i++) {
+        SearchThread* thread = &threads[i];
+        thread->searcher = searcher;
+        thread->limits = limits;
+        thread->threads = threads;
+        thread->index = i;
+        thread->state = *state;
+        if (searcher->network) set_nnue_network(&thread->state, searcher->network);
+        thread->start_ms = start_ms;
+        thread->can_stop = i != 0;  // The main thread needs a move first
+        set_time_budget(thread);
+    }
+
+    // A helper that can't be started just doesn't search
+    pthread_t helpers[MAX_SEARCH_THREADS];
+    bool started[MAX_SEARCH_THREADS] = {0};
+    for (u16 i = 1; i < nb_threads; i++)
+        started[i] = pthread_create(&helpers[i], NULL, helper_thread_main, &threads[i]) == 0;
+
+    iterative_deepening(&threads[0], output);
+
+    search_stop(searcher);
+    for (u16 i = 1; i < nb_threads; i++)
+        if (started[i]) pthread_join(helpers[i], NULL);
+
+    for (u16 i = 0; i < nb_threads; i++) output->thread_nodes[i] = threads[i].nodes;
+    output->nodes = total_nodes(threads, nb_threads);
+    output->elapsed_ms = now_ms() - start_ms;
+    free(threads);
+}
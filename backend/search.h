@@ -0,0 +1,88 @@
+// vim:ft=c
+#pragma once
+
+#include "lib.h"
+#include "tablebase.h"
+#include "transposition.h"
+
+#define MAX_PLY 128
+#define MAX_SEARCH_THREADS 256
+
+// Being mated in `n` plies scores `-MATE_SCORE + n`, anything past `MATE_BOUND`
+// is a mate.
+#define MATE_SCORE 32000
+#define MATE_BOUND (MATE_SCORE - MAX_PLY)
+
+// Zero means no limit. Without any limit, the search only stops at `MAX_PLY`.
+typedef struct {
+    u8 depth;
+    u64 nodes;
+    u32 move_time_ms;
+
+    // The same clocks as the frontend's chrono, only used without
+    // `move_time_ms`. The search takes a slice of the side to play's time.
+    u32 time_left_ms[2];  // [PieceColor]
+    u32 increment_ms[2];
+    u16 moves_to_go;      // Until the next time control, 0 when there is none
+
+    // Searching on the opponent's time, the clocks only start running once
+    // `search_ponderhit` clears it. Both are read during the search.
+    bool ponder;
+    u64 ponderhit_ms;
+} SearchLimits;
+
+typedef struct {
+    Move best_move;  // `start == end` when there is no legal move
+    i32 score;       // Centipawns for the side to play
+    u8 depth;        // Last depth searched completely
+    u64 nodes;  // All threads together
+    u32 elapsed_ms;
+
+    u16 nb_threads;
+    u64 thread_nodes[MAX_SEARCH_THREADS];
+
+    u8 pv_length;
+    Move pv[MAX_PLY];  // Principal variation, starts with `best_move`
+} SearchResult;
+
+// Called by the main search thread after each completed iteration
+typedef void (*SearchInfoCallback)(const SearchResult* result, void* context);
+
+// Keeps the transposition table between searches, one per game is enough.
+//
+// With more than one thread, all of them search the same position and only
+// share the transposition table (Lazy SMP): what one thread finds speeds up
+// the others. The first thread is the one that reports the result.
+typedef struct {
+    TranspositionTable* tt;
+    const Tablebases* tablebases;  // Optional, belongs to the caller
+    const NnueNetwork* network;    // Same, otherwise the state's own is kept
+    u16 nb_threads;
+    SearchInfoCallback info_callback;  // Optional
+    void* info_context;
+    bool stop;  // Only touched atomically
+} Searcher;
+
+Searcher* searcher_create(size_t hash_mb);
+void searcher_destroy(Searcher* searcher);
+void searcher_new_game(Searcher* searcher);
+void searcher_set_threads(Searcher* searcher, u16 nb_threads);
+void searcher_set_tablebases(Searcher* searcher, const Tablebases* tablebases);
+void searcher_set_network(Searcher* searcher, const NnueNetwork* network);
+void searcher_set_info_callback(Searcher* searcher, SearchInfoCallback callback, void* context);
+
+// Can be called from any thread, `search_best_move` then returns as soon as
+// possible with the last completed iteration.
+void search_stop(Searcher* searcher);
+
+// `search_best_move` leaves the stop flag set when it returns, and doesn't
+// clear it when it starts: a `search_stop` sent before the search thread gets
+// going would be lost. This goes before each search, from the thread that
+// starts it.
+void search_clear_stop(Searcher* searcher);
+
+// The opponent played the expected move, the search using `limits` goes on
+// with its time limits from now. Can be called from any thread too.
+void search_ponderhit(SearchLimits* limits);
+
+void search_best_move(Searcher* searcher, const GameState* state, const SearchLimits* limits, SearchResult* output);
@@ -0,0 +1,627 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "tablebase.h"
+#include "thread_pool.h"
+
+#define TB_MAGIC 0x3142544B43454843ull  // "CHECKTB1"
+
+// Positions are indexed by the side to play, then the square of each piece
+// in table order: white king, black king, then the others by decreasing code.
+// There is no symmetry trick, a 4-piece table has 2 * 64^4 positions.
+typedef struct {
+    u8 nb_pieces;
+    Cell pieces[TB_MAX_PIECES];
+} Material;
+
+// Codes of the pieces other than kings, 0 for no piece
+static inline u8 piece_code(Cell piece) { return 1 + piece.color * 5 + piece.type; }
+
+static u8 material_key(const Material* material) {
+    const u8 code_1 = material->nb_pieces > 2 ? piece_code(material->pieces[2]) : 0;
+    const u8 code_2 = material->nb_pieces > 3 ? piece_code(material->pieces[3]) : 0;
+    return code_1 * 11 + code_2;
+}
+
+static void sort_material(Material* material) {
+    if (material->nb_pieces == 4 && piece_code(material->pieces[3]) > piece_code(material->pieces[2])) {
+        const Cell piece = material->pieces[2];
+        material->pieces[2] = material->pieces[3];
+        material->pieces[3] = piece;
+    }
+}
+
+static Material mirror_material(const Material* material) {
+    Material mirrored = *material;
+    for (u8 i = 0; i < material->nb_pieces; i++) mirrored.pieces[i].color ^= 1;
+    mirrored.pieces[0] = material->pieces[1];
+    mirrored.pieces[1] = material->pieces[0];
+    mirrored.pieces[0].color = WHITE;
+    mirrored.pieces[1].color = BLACK;
+    sort_material(&mirrored);
+    return mirrored;
+}
+
+// Only one of a material and its mirror gets a table
+static bool is_canonical(const Material* material) {
+    const Material mirrored = mirror_material(material);
+    return material_key(material) <= material_key(&mirrored);
+}
+
+static void material_name(const Material* material, char* output) {
+    static const char piece_letters[] = { [PAWN] = 'P', [ROOK] = 'R', [KNIGHT] = 'N', [BISHOP] = 'B', [QWEEN] = 'Q' };
+    *output++ = 'K';
+    for (u8 i = 2; i < material->nb_pieces; i++)
+        if (material->pieces[i].color == WHITE) *output++ = piece_letters[material->pieces[i].type];
+    *output++ = 'v';
+    *output++ = 'K';
+    for (u8 i = 2; i < material->nb_pieces; i++)
+        if (material->pieces[i].color == BLACK) *output++ = piece_letters[material->pieces[i].type];
+    *output = '\0';
+}
+
+static bool parse_material(const char* str, Material* output) {
+    *output = (Material) { .nb_pieces = 2, .pieces = { { WHITE, KING }, { BLACK, KING } } };
+    if (*str++ != 'K') return false;
+
+    PieceColor color = WHITE;
+    for (; *str; str++) {
+        PiecesType type;
+        switch (*str) {
+            case 'v': continue;
+            case 'K':
+                if (color == BLACK) return false;
+                color = BLACK;
+                continue;
+            case 'P': type = PAWN; break;
+            case 'R': type = ROOK; break;
+            case 'N': type = KNIGHT; break;
+            case 'B': type = BISHOP; break;
+            case 'Q': type = QWEEN; break;
+            default: return false;
+        }
+        if (output->nb_pieces == TB_MAX_PIECES) return false;
+        output->pieces[output->nb_pieces++] = (Cell) { color, type };
+    }
+
+    sort_material(output);
+    return color == BLACK;
+}
+
+static inline u64 nb_positions_of(u8 nb_pieces) { return 2ull << (6 * nb_pieces); }
+
+static inline u64 position_index(PieceColor color_to_play, const Square* squares, u8 nb_pieces) {
+    u64 index = color_to_play;
+    for (u8 i = 0; i < nb_pieces; i++) index = index << 6 | squares[i];
+    return index;
+}
+
+static inline void decode_index(u64 index, u8 nb_pieces, Square* squares, PieceColor* color_to_play) {
+    for (u8 i = nb_pieces; i-- > 0; index >>= 6) squares[i] = index & 63;
+    *color_to_play = index;
+}
+
+static Tablebase* map_table(const char* path) {
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || file_stat.st_size < (off_t) sizeof(TbHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    const u8* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return NULL;
+
+    const TbHeader* header = (const TbHeader*) data;
+    const size_t wdl_size = (header->nb_positions / 4 + 7) & ~7ull;
+    if (header->magic != TB_MAGIC || header->nb_pieces > TB_MAX_PIECES
+            || header->nb_positions != nb_positions_of(header->nb_pieces)
+            || sizeof(TbHeader) + wdl_size + (header->nb_positions * header->dtm_bits + 63) / 64 * 8 > (size_t) file_stat.st_size) {
+        munmap((void*) data, file_stat.st_size);
+        return NULL;
+    }
+
+    Tablebase* table = malloc(sizeof(Tablebase));
+    if (table == NULL) {
+        munmap((void*) data, file_stat.st_size);
+        return NULL;
+    }
+    *table = (Tablebase) {
+        .header = header,
+        .file_size = file_stat.st_size,
+        .wdl = data + sizeof(TbHeader),
+        .dtm = (const u64*) (data + sizeof(TbHeader) + wdl_size),
+    };
+    return table;
+}
+
+static Material header_material(const TbHeader* header) {
+    Material material = { .nb_pieces = header->nb_pieces };
+    for (u8 i = 0; i < header->nb_pieces; i++)
+        material.pieces[i] = (Cell) { .color = header->pieces[i] >> 3, .type = header->pieces[i] & 7 };
+    return material;
+}
+
+static bool add_table(Tablebases* tablebases, Tablebase* table) {
+    const Material material = header_material(table->header);
+    const u8 key = material_key(&material);
+    if (tablebases->tables[key] != NULL) return false;
+    tablebases->tables[key] = table;
+    return true;
+}
+
+static void unmap_table(Tablebase* table) {
+    munmap((void*) table->header, table->file_size);
+    free(table);
+}
+
+Tablebases* tablebases_create(void) {
+    return calloc(1, sizeof(Tablebases));
+}
+
+void tablebases_destroy(Tablebases* tablebases) {
+    if (tablebases == NULL) return;
+    for (size_t i = 0; i < TB_NB_MATERIALS; i++)
+        if (tablebases->tables[i]) unmap_table(tablebases->tables[i]);
+    free(tablebases);
+}
+
+bool tablebases_load_directory(Tablebases* tablebases, const char* directory) {
+    DIR* dir = opendir(directory);
+    if (dir == NULL) return false;
+
+    char path[4096];
+    const struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const size_t length = strlen(entry->d_name);
+        if (length < 3 || strcmp(entry->d_name + length - 3, ".tb")) continue;
+
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        Tablebase* table = map_table(path);
+        if (table && !add_table(tablebases, table)) unmap_table(table);
+    }
+
+    closedir(dir);
+    return true;
+}
+
+static inline TbResult read_table(const Tablebase* table, u64 index) {
+    const TbWdl wdl = (table->wdl[index / 4] >> (index % 4 * 2)) & 3;
+    const u8 dtm_bits = table->header->dtm_bits;
+    if (dtm_bits == 0) return (TbResult) { wdl, 0 };
+
+    // A value can straddle two words
+    const u64 bit = index * dtm_bits;
+    u64 value = table->dtm[bit / 64] >> (bit % 64);
+    if (bit % 64 + dtm_bits > 64) value |= table->dtm[bit / 64 + 1] << (64 - bit % 64);
+    return (TbResult) { wdl, value & ((1u << dtm_bits) - 1) };
+}
+
+bool tablebases_probe(const Tablebases* tablebases, const GameState* state, TbResult* output) {
+    const Bitboards* bitboards = &state->bitboards;
+    if (popcount(bitboards->occupied) > TB_MAX_PIECES || state->castling_rights) return false;
+    if (get_en_passant_column(state) >= 0) return false;
+
+    Material material = { .nb_pieces = 2, .pieces = { { WHITE, KING }, { BLACK, KING } } };
+    for (PieceColor color = WHITE; color <= BLACK; color++)
+        for (PiecesType type = PAWN; type < KING; type++)
+            for (u8 i = popcount(bitboards->pieces[color][type]); i > 0; i--)
+                material.pieces[material.nb_pieces++] = (Cell) { color, type };
+    sort_material(&material);
+
+    // Black with the material of the table's white: look at the board upside
+    // down with the colors swapped
+    const u8 flip = is_canonical(&material) ? 0 : 1;
+    if (flip) material = mirror_material(&material);
+
+    const Tablebase* table = tablebases->tables[material_key(&material)];
+    if (table == NULL) return false;
+
+    Square squares[TB_MAX_PIECES];
+    for (u8 i = 0; i < material.nb_pieces; i++) {
+        const Cell piece = material.pieces[i];
+        Bitboard pieces = bitboards->pieces[piece.color ^ flip][piece.type];
+        // Two identical pieces: the second one takes the other square
+        if (i == 3 && piece_code(piece) == piece_code(material.pieces[2])) pieces &= pieces - 1;
+        squares[i] = lsb(pieces) ^ (flip ? 56 : 0);
+    }
+
+    *output = read_table(table, position_index(state->color_to_play ^ flip, squares, material.nb_pieces));
+    return output->wdl != TB_ILLEGAL;
+}
+
+bool tablebases_best_move(const Tablebases* tablebases, GameState* state, Move* output, TbResult* result) {
+    Move moves[MAX_MOVES];
+    const size_t nb_moves = generate_legal_moves(state, moves);
+    if (nb_moves == 0) return false;
+
+    // Scores the moves from the mover's point of view: fast wins first, then
+    // draws, then slow losses
+    i32 best_score = INT32_MIN;
+    for (size_t i = 0; i < nb_moves; i++) {
+        TbResult child;
+        make_move(state, moves[i]);
+        const bool found = tablebases_probe(tablebases, state, &child);
+        unmake_move(state);
+        if (!found) return false;
+
+        const i32 score = child.wdl == TB_LOSS ? 1000 - child.dtm : child.wdl == TB_WIN ? -1000 + child.dtm : 0;
+        if (score > best_score) {
+            best_score = score;
+            *output = moves[i];
+            *result = (TbResult) {
+                .wdl = child.wdl == TB_LOSS ? TB_WIN : child.wdl == TB_WIN ? TB_LOSS : TB_DRAW,
+                .dtm = child.wdl == TB_DRAW ? 0 : child.dtm + 1,
+            };
+        }
+    }
+    return true;
+}
+
+// Generation
+
+enum { GEN_UNKNOWN, GEN_WIN, GEN_LOSS, GEN_DRAW, GEN_ILLEGAL };
+
+#define NONE 255  // No pending level, or a way out of losing
+#define TASK_SIZE (1 << 14)
+
+typedef struct {
+    const Tablebases* tablebases;
+    Material material;
+    u64 nb_positions;
+
+    u8* status;
+    u8* dtm;
+    u8* counter;       // Moves staying in the table whose result isn't a win for the opponent yet
+    u8* pending_win;   // Level at which the position is known to be won
+    u8* pending_loss;  // Level at which the position is known to be lost
+    u8* exit_loss;     // Loss level forced by captures and promotions, NONE if one of them doesn't lose
+
+    u8 level;
+    u8 max_pending;
+} Generator;
+
+static void atomic_min(u8* value, u8 candidate) {
+    u8 current = __atomic_load_n(value, __ATOMIC_RELAXED);
+    while (candidate < current && !__atomic_compare_exchange_n(value, &current, candidate, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void atomic_max(u8* value, u8 candidate) {
+    u8 current = __atomic_load_n(value, __ATOMIC_RELAXED);
+    while (candidate > current && !__atomic_compare_exchange_n(value, &current, candidate, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void clear_state(GameState* state) {
+    for (Square square = 0; square < 64; square++) state->board[square >> 3][square & 7] = EMPTY_CELL;
+    state->bitboards = (Bitboards) {0};
+    state->king_status = NO_CHECKS;
+    state->castling_rights = 0;
+    state->last_move = (LastMove) {0};
+    state->halfmove_clock = 0;
+    state->fullmove_number = 1;
+    state->undo_top = 0;
+    state->nb_undo_records = 0;
+    state->nnue.network = NULL;
+}
+
+static void place_pieces(GameState* state, const Material* material, const Square* squares, bool remove) {
+    for (u8 i = 0; i < material->nb_pieces; i++) {
+        const Square square = squares[i];
+        if (remove) {
+            bitboards_remove_piece(&state->bitboards, square, material->pieces[i]);
+            state->board[square >> 3][square & 7] = EMPTY_CELL;
+        } else {
+            bitboards_put_piece(&state->bitboards, square, material->pieces[i]);
+            state->board[square >> 3][square & 7] = material->pieces[i];
+        }
+    }
+}
+
+static void init_position(Generator* generator, GameState* state, u64 index) {
+    const Material* material = &generator->material;
+    Square squares[TB_MAX_PIECES];
+    PieceColor color_to_play;
+    decode_index(index, material->nb_pieces, squares, &color_to_play);
+
+    generator->status[index] = GEN_ILLEGAL;
+    generator->pending_win[index] = NONE;
+    generator->pending_loss[index] = NONE;
+    generator->exit_loss[index] = NONE;
+
+    Bitboard occupied = 0;
+    for (u8 i = 0; i < material->nb_pieces; i++) {
+        if (occupied & square_bb(squares[i])) return;
+        occupied |= square_bb(squares[i]);
+        if (material->pieces[i].type == PAWN && (squares[i] >> 3 == 0 || squares[i] >> 3 == 7)) return;
+    }
+
+    place_pieces(state, material, squares, false);
+    attack_maps_from_bitboards(&state->bitboards, &state->attacks);
+    state->color_to_play = color_to_play;
+    const Bitboards* bitboards = &state->bitboards;
+    const PieceColor waiting_color = color_to_play ^ 1;
+
+    if (is_square_attacked(bitboards, lsb(bitboards->pieces[waiting_color][KING]), color_to_play)) {
+        place_pieces(state, material, squares, true);
+        return;
+    }
+
+    generator->status[index] = GEN_UNKNOWN;
+    const bool in_check = is_square_attacked(bitboards, lsb(bitboards->pieces[color_to_play][KING]), waiting_color);
+
+    Move moves[MAX_MOVES];
+    const size_t nb_moves = generate_legal_moves(state, moves);
+    u8 counter = 0;
+    u8 exit_loss = 0;
+    u8 pending_win = NONE;
+
+    for (size_t i = 0; i < nb_moves; i++) {
+        if (!(moves[i].flags & (MOVE_CAPTURE | MOVE_PROMOTION))) {
+            counter++;
+            continue;
+        }
+
+        // Leaves the table, the smaller table has the answer
+        TbResult child;
+        make_move(state, moves[i]);
+        const bool found = tablebases_probe(generator->tablebases, state, &child);
+        unmake_move(state);
+
+        if (found && child.wdl == TB_LOSS) {
+            if (child.dtm + 1 < pending_win) pending_win = child.dtm + 1;
+        } else if (found && child.wdl == TB_WIN) {
+            if (exit_loss != NONE && child.dtm + 1 > exit_loss) exit_loss = child.dtm + 1;
+        } else {
+            exit_loss = NONE;
+        }
+    }
+
+    place_pieces(state, material, squares, true);
+
+    if (nb_moves == 0) {
+        if (in_check) generator->pending_loss[index] = 0;
+        else generator->status[index] = GEN_DRAW;
+        return;
+    }
+
+    generator->counter[index] = counter;
+    generator->exit_loss[index] = exit_loss;
+    generator->pending_win[index] = pending_win;
+    if (pending_win != NONE) atomic_max(&generator->max_pending, pending_win);
+    if (counter == 0 && exit_loss != NONE && pending_win == NONE) {
+        generator->pending_loss[index] = exit_loss;
+        atomic_max(&generator->max_pending, exit_loss);
+    }
+}
+
+static void init_task(void* context, u16 thread_index, size_t task) {
+    (void) thread_index;
+    Generator* generator = context;
+    GameState state;
+    clear_state(&state);
+
+    const u64 end = (task + 1) * TASK_SIZE < generator->nb_positions ? (task + 1) * TASK_SIZE : generator->nb_positions;
+    for (u64 index = task * TASK_SIZE; index < end; index++) init_position(generator, &state, index);
+}
+
+static void resolve_task(void* context, u16 thread_index, size_t task) {
+    (void) thread_index;
+    Generator* generator = context;
+    const u8 level = generator->level;
+
+    const u64 end = (task + 1) * TASK_SIZE < generator->nb_positions ? (task + 1) * TASK_SIZE : generator->nb_positions;
+    for (u64 index = task * TASK_SIZE; index < end; index++) {
+        if (generator->status[index] != GEN_UNKNOWN) continue;
+        if (generator->pending_win[index] == level) {
+            generator->status[index] = GEN_WIN;
+            generator->dtm[index] = level;
+        } else if (generator->pending_loss[index] == level) {
+            generator->status[index] = GEN_LOSS;
+            generator->dtm[index] = level;
+        }
+    }
+}
+
+// Cells a piece could have come from with a quiet move. Pawns only move
+// forward, and never come from their first or last row.
+static Bitboard unmove_origins(Cell piece, Square square, Bitboard occupied) {
+    if (piece.type != PAWN) return piece_attacks(piece, square, occupied) & ~occupied;
+
+    const i8 backward = piece.color == WHITE ? 8 : -8;
+    const Square one_back = square + backward;
+    if (occupied & square_bb(one_back)) return 0;
+
+    Bitboard origins = 0;
+    const u8 one_back_row = one_back >> 3;
+    if (one_back_row != 0 && one_back_row != 7) origins |= square_bb(one_back);
+
+    // Double push, landing on the fourth row of its side
+    const u8 double_push_row = piece.color == WHITE ? 4 : 3;
+    if (square >> 3 == double_push_row && !(occupied & square_bb(one_back + backward)))
+        origins |= square_bb(one_back + backward);
+    return origins;
+}
+
+static void retrograde_task(void* context, u16 thread_index, size_t task) {
+    (void) thread_index;
+    Generator* generator = context;
+    const Material* material = &generator->material;
+    const u8 level = generator->level;
+
+    const u64 end = (task + 1) * TASK_SIZE < generator->nb_positions ? (task + 1) * TASK_SIZE : generator->nb_positions;
+    for (u64 index = task * TASK_SIZE; index < end; index++) {
+        const u8 status = generator->status[index];
+        if ((status != GEN_WIN && status != GEN_LOSS) || generator->dtm[index] != level) continue;
+
+        Square squares[TB_MAX_PIECES];
+        PieceColor color_to_play;
+        decode_index(index, material->nb_pieces, squares, &color_to_play);
+        const PieceColor mover = color_to_play ^ 1;
+
+        Bitboard occupied = 0;
+        for (u8 i = 0; i < material->nb_pieces; i++) occupied |= square_bb(squares[i]);
+
+        // Every position where the other side played a quiet move to get here
+        for (u8 i = 0; i < material->nb_pieces; i++) {
+            if (material->pieces[i].color != mover) continue;
+
+            const Square square = squares[i];
+            Bitboard origins = unmove_origins(material->pieces[i], square, occupied);
+            while (origins) {
+                squares[i] = pop_lsb(&origins);
+                const u64 previous = position_index(mover, squares, material->nb_pieces);
+                if (generator->status[previous] != GEN_UNKNOWN) continue;
+
+                if (status == GEN_LOSS) {
+                    atomic_min(&generator->pending_win[previous], level + 1);
+                    atomic_max(&generator->max_pending, level + 1);
+                } else if (__atomic_sub_fetch(&generator->counter[previous], 1, __ATOMIC_RELAXED) == 0) {
+                    // Every move loses: as late as possible
+                    const u8 exit_loss = generator->exit_loss[previous];
+                    if (exit_loss != NONE && generator->pending_win[previous] == NONE) {
+                        const u8 loss_level = exit_loss > level + 1 ? exit_loss : level + 1;
+                        generator->pending_loss[previous] = loss_level;
+                        atomic_max(&generator->max_pending, loss_level);
+                    }
+                }
+            }
+            squares[i] = square;
+        }
+    }
+}
+
+static bool write_table(const Generator* generator, const char* path) {
+    const u64 nb_positions = generator->nb_positions;
+
+    u8 max_dtm = 0;
+    for (u64 i = 0; i < nb_positions; i++)
+        if ((generator->status[i] == GEN_WIN || generator->status[i] == GEN_LOSS) && generator->dtm[i] > max_dtm)
+            max_dtm = generator->dtm[i];
+    u8 dtm_bits = 0;
+    while ((1u << dtm_bits) <= max_dtm) dtm_bits++;
+
+    TbHeader header = {
+        .magic = TB_MAGIC,
+        .nb_pieces = generator->material.nb_pieces,
+        .dtm_bits = dtm_bits,
+        .nb_positions = nb_positions,
+    };
+    for (u8 i = 0; i < header.nb_pieces; i++)
+        header.pieces[i] = generator->material.pieces[i].color << 3 | generator->material.pieces[i].type;
+
+    const size_t wdl_size = (nb_positions / 4 + 7) & ~7ull;
+    const size_t dtm_size = (nb_positions * dtm_bits + 63) / 64 * 8;
+    u8* wdl = calloc(wdl_size, 1);
+    u64* dtm = calloc(dtm_size / 8 + 1, sizeof(u64));
+    if (wdl == NULL || dtm == NULL) {
+        free(wdl);
+        free(dtm);
+        return false;
+    }
+
+    for (u64 i = 0; i < nb_positions; i++) {
+        static const TbWdl wdl_of_status[] = {
+            [GEN_UNKNOWN] = TB_DRAW, [GEN_WIN] = TB_WIN, [GEN_LOSS] = TB_LOSS, [GEN_DRAW] = TB_DRAW, [GEN_ILLEGAL] = TB_ILLEGAL,
+        };
+        const u8 status = generator->status[i];
+        wdl[i / 4] |= wdl_of_status[status] << (i % 4 * 2);
+
+        if (status != GEN_WIN && status != GEN_LOSS) continue;
+        const u64 bit = i * dtm_bits;
+        dtm[bit / 64] |= (u64) generator->dtm[i] << (bit % 64);
+        if (bit % 64 + dtm_bits > 64) dtm[bit / 64 + 1] |= (u64) generator->dtm[i] >> (64 - bit % 64);
+    }
+
+    FILE* file = fopen(path, "wb");
+    bool ok = file != NULL
+        && fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(wdl, wdl_size, 1, file) == 1
+        && (dtm_size == 0 || fwrite(dtm, dtm_size, 1, file) == 1);
+    if (file && fclose(file) != 0) ok = false;
+
+    free(wdl);
+    free(dtm);
+    return ok;
+}
+
+static bool generate_table(Tablebases* tablebases, const Material* material, const char* path, u16 nb_threads) {
+    Generator generator = {
+        .tablebases = tablebases,
+        .material = *material,
+        .nb_positions = nb_positions_of(material->nb_pieces),
+    };
+
+    u8* arrays = malloc(generator.nb_positions * 6);
+    if (arrays == NULL) return false;
+    generator.status = arrays;
+    generator.dtm = arrays + generator.nb_positions;
+    generator.counter = arrays + generator.nb_positions * 2;
+    generator.pending_win = arrays + generator.nb_positions * 3;
+    generator.pending_loss = arrays + generator.nb_positions * 4;
+    generator.exit_loss = arrays + generator.nb_positions * 5;
+
+    const size_t nb_tasks = (generator.nb_positions + TASK_SIZE - 1) / TASK_SIZE;
+    parallel_for(nb_tasks, nb_threads, init_task, &generator);
+
+    // Level n finds every position won or lost in n plies
+    for (u16 level = 0; level <= generator.max_pending && level < NONE; level++) {
+        generator.level = level;
+        parallel_for(nb_tasks, nb_threads, resolve_task, &generator);
+        parallel_for(nb_tasks, nb_threads, retrograde_task, &generator);
+    }
+
+    const bool ok = write_table(&generator, path);
+    free(arrays);
+    return ok;
+}
+
+static bool ensure_table(Tablebases* tablebases, Material material, const char* directory, u16 nb_threads) {
+    sort_material(&material);
+    if (!is_canonical(&material)) material = mirror_material(&material);
+    if (tablebases->tables[material_key(&material)] != NULL) return true;
+
+    // Captures and promotions lead to other tables, they are needed first
+    for (u8 i = 2; i < material.nb_pieces; i++) {
+        Material captured = material;
+        captured.pieces[i] = captured.pieces[--captured.nb_pieces];
+        if (!ensure_table(tablebases, captured, directory, nb_threads)) return false;
+
+        if (material.pieces[i].type != PAWN) continue;
+        static const PiecesType promotions[] = { QWEEN, ROOK, BISHOP, KNIGHT };
+        for (size_t j = 0; j < 4; j++) {
+            Material promoted = material;
+            promoted.pieces[i].type = promotions[j];
+            if (!ensure_table(tablebases, promoted, directory, nb_threads)) return false;
+        }
+    }
+
+    char name[16];
+    char path[4096];
+    material_name(&material, name);
+    snprintf(path, sizeof(path), "%s/%s.tb", directory, name);
+
+    Tablebase* table = map_table(path);
+    if (table == NULL) {
+        if (!generate_table(tablebases, &material, path, nb_threads)) return false;
+        table = map_table(path);
+    }
+    if (table == NULL) return false;
+
+    add_table(tablebases, table);
+    return true;
+}
+
+bool tablebases_generate(Tablebases* tablebases, const char* material_str, const char* directory, u16 nb_threads) {
+    Material material;
+    if (!parse_material(material_str, &material)) return false;
+    return ensure_table(tablebases, material, directory, nb_threads);
+}
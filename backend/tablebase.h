@@ -0,0 +1,57 @@
+// vim:ft=c
+#pragma once
+
+#include "lib.h"
+
+// Kings plus at most two other pieces
+#define TB_MAX_PIECES 4
+
+// One table per material: two piece codes below 11, kings aside
+#define TB_NB_MATERIALS 121
+
+typedef enum: u8 { TB_DRAW, TB_WIN, TB_LOSS, TB_ILLEGAL } TbWdl;
+
+// For the side to play. `dtm` is how many plies until mate, for both sides.
+typedef struct {
+    TbWdl wdl;
+    u8 dtm;
+} TbResult;
+
+// How a table file starts, the mapped file being used as is
+typedef struct {
+    u64 magic;
+    u8 nb_pieces;
+    u8 dtm_bits;
+    u8 pieces[TB_MAX_PIECES];  // `color << 3 | type`, kings first
+    u8 padding[2];
+    u64 nb_positions;
+} TbHeader;
+
+typedef struct {
+    const TbHeader* header;  // Mapped file
+    size_t file_size;
+    const u8* wdl;    // 2 bits per position
+    const u64* dtm;   // `dtm_bits` per position
+} Tablebase;
+
+typedef struct {
+    Tablebase* tables[TB_NB_MATERIALS];
+} Tablebases;
+
+Tablebases* tablebases_create(void);
+void tablebases_destroy(Tablebases* tablebases);
+
+// Maps every `.tb` file of the directory
+bool tablebases_load_directory(Tablebases* tablebases, const char* directory);
+
+// `material` is like "KQK", "KRvK" or "KBNK", white's pieces first. Every table
+// it leads to (after a capture or a promotion) is made first if it's missing.
+// All of them are written to `directory` and loaded. Positions with castling
+// rights or an en passant target aren't part of the tables.
+bool tablebases_generate(Tablebases* tablebases, const char* material, const char* directory, u16 nb_threads);
+
+// O(1), no allocation. False if the position isn't in the loaded tables.
+bool tablebases_probe(const Tablebases* tablebases, const GameState* state, TbResult* output);
+
+// The move that wins the fastest, or loses the slowest
+bool tablebases_best_move(const Tablebases* tablebases, GameState* state, Move* output, TbResult* result);
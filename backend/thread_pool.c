@@ -0,0 +1,103 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "thread_pool.h"
+
+// Tasks [begin, end) left to a thread. The owner takes them from the front,
+// thieves from the back.
+typedef struct {
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+} TaskQueue;
+
+typedef struct {
+    TaskQueue* queues;
+    u16 nb_threads;
+    TaskFunction function;
+    void* context;
+} Pool;
+
+typedef struct {
+    Pool* pool;
+    u16 index;
+} Worker;
+
+u16 default_thread_count(void) {
+    const long nb_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nb_cores < 1) return 1;
+    return nb_cores > MAX_POOL_THREADS ? MAX_POOL_THREADS : nb_cores;
+}
+
+static bool pop_task(TaskQueue* queue, size_t* task) {
+    pthread_mutex_lock(&queue->lock);
+    const bool found = queue->begin < queue->end;
+    if (found) *task = queue->begin++;
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static bool steal_tasks(Pool* pool, u16 thief) {
+    for (u16 i = 1; i < pool->nb_threads; i++) {
+        TaskQueue* victim = &pool->queues[(thief + i) % pool->nb_threads];
+
+        pthread_mutex_lock(&victim->lock);
+        const size_t nb_left = victim->end - victim->begin;
+        const size_t end = victim->end;
+        const size_t nb_stolen = (nb_left + 1) / 2;
+        victim->end -= nb_stolen;
+        pthread_mutex_unlock(&victim->lock);
+
+        if (nb_stolen) {
+            TaskQueue* queue = &pool->queues[thief];
+            pthread_mutex_lock(&queue->lock);
+            queue->begin = end - nb_stolen;
+            queue->end = end;
+            pthread_mutex_unlock(&queue->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void* worker_main(void* arg) {
+    const Worker* worker = arg;
+    Pool* pool = worker->pool;
+
+    size_t task;
+    do {
+        while (pop_task(&pool->queues[worker->index], &task))
+            pool->function(pool->context, worker->index, task);
+    } while (steal_tasks(pool, worker->index));
+
+    return NULL;
+}
+
+void parallel_for(size_t nb_tasks, u16 nb_threads, TaskFunction function, void* context) {
+    if (nb_threads == 0) nb_threads = default_thread_count();
+    if (nb_threads > MAX_POOL_THREADS) nb_threads = MAX_POOL_THREADS;
+    if (nb_threads > nb_tasks) nb_threads = nb_tasks ? nb_tasks : 1;
+
+    TaskQueue queues[MAX_POOL_THREADS];
+    Worker workers[MAX_POOL_THREADS];
+    Pool pool = { .queues = queues, .nb_threads = nb_threads, .function = function, .context = context };
+
+    for (u16 i = 0; i < nb_threads; i++) {
+        pthread_mutex_init(&queues[i].lock, NULL);
+        queues[i].begin = nb_tasks * i / nb_threads;
+        queues[i].end = nb_tasks * (i + 1) / nb_threads;
+        workers[i] = (Worker) { .pool = &pool, .index = i };
+    }
+
+    // A thread that can't be started leaves its slice to be stolen
+    pthread_t threads[MAX_POOL_THREADS];
+    bool started[MAX_POOL_THREADS] = {0};
+    for (u16 i = 1; i < nb_threads; i++)
+        started[i] = pthread_create(&threads[i], NULL, worker_main, &workers[i]) == 0;
+    worker_main(&workers[0]);
+
+    for (u16 i = 1; i < nb_threads; i++)
+        if (started[i]) pthread_join(threads[i], NULL);
+    for (u16 i = 0; i < nb_threads; i++) pthread_mutex_destroy(&queues[i].lock);
+}
@@ -0,0 +1,17 @@
+// vim:ft=c
+#pragma once
+
+#include "common_types.h"
+
+#define MAX_POOL_THREADS 256
+
+typedef void (*TaskFunction)(void* context, u16 thread_index, size_t task);
+
+// One per core
+u16 default_thread_count(void);
+
+// Runs `function(context, thread_index, task)` for every task in
+// [0, nb_tasks), on `nb_threads` threads (0 for one per core) including the
+// calling one. Each thread starts with its own slice of the tasks, and steals
+// half of what's left in another thread's slice once it's done with its own.
+void parallel_for(size_t nb_tasks, u16 nb_threads, TaskFunction function, void* context);
@@ -0,0 +1,573 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lib.h"
+#include "fen.h"
+#include "epd.h"
+#include "packed.h"
+#include "thread_pool.h"
+
+// Matches between two UCI engines, "A" being the one under test and "B" the
+// reference, usually two builds of `.build/uci`. Every game seat runs its own
+// process of each. Openings are played twice, once with each color, and the
+// clocks work like the frontend's chrono: a fixed time per side, only running
+// while that side is to play.
+
+// How long an engine gets to answer `uci` and `isready`, and how late past its
+// clock a move can come before the engine is considered stuck
+#define HANDSHAKE_TIMEOUT_MS 10000
+#define MOVE_TIMEOUT_MARGIN_MS 5000
+
+extern char** environ;
+
+typedef struct {
+    const char* path;
+    const char* eval_path;  // Sent as EvalFile, NULL to keep the engine's default
+    size_t hash_mb;
+    u64 nodes;  // Optional limit per move, on top of the clock
+} EngineConfig;
+
+typedef enum: u8 { A_WINS, DRAW, B_WINS } GameOutcome;
+
+typedef enum: u8 {
+    END_MATE, END_STALEMATE, END_REPETITION, END_FIFTY_MOVES, END_TIME, END_ILLEGAL_MOVE, END_DISCONNECT, END_COUNT,
+} GameEnd;
+
+static const char* end_names[END_COUNT] = {
+    [END_MATE] = "mate", [END_STALEMATE] = "stalemate", [END_REPETITION] = "repetition",
+    [END_FIFTY_MOVES] = "50 moves", [END_TIME] = "time", [END_ILLEGAL_MOVE] = "illegal move",
+    [END_DISCONNECT] = "disconnect",
+};
+
+// One running engine, talked to through pipes. Lines are read by hand rather
+// than through stdio, so that waiting for one can time out.
+typedef struct {
+    pid_t pid;  // 0 when not running
+    int input;  // The engine's stdin
+    int output; // The engine's stdout
+    char buffer[4096];
+    size_t buffer_start;
+    size_t buffer_end;
+} EngineProcess;
+
+// What a game thread works with, never shared
+typedef struct {
+    GameState* state;
+    EngineProcess engines[2];  // [engine], 0 is A
+    char* moves;  // The game so far in UCI notation, for `position`
+    size_t moves_capacity;
+} Seat;
+
+typedef struct {
+    EngineConfig engines[2];
+    PackedPosition* openings;
+    size_t nb_openings;
+    size_t openings_capacity;
+    u32 time_ms;       // Per side and per game
+    u32 increment_ms;
+    size_t nb_games;   // At most
+    u16 nb_threads;
+    Seat* seats;       // [thread index]
+
+    // SPRT between elo0 (H0) and elo1 (H1)
+    f64 elo0;
+    f64 elo1;
+    f64 alpha;
+    f64 beta;
+
+    pthread_mutex_t lock;  // For everything below
+    u64 outcomes[3];       // [GameOutcome]
+    u64 ends[END_COUNT];
+    bool finished;         // Once the SPRT decided, the games left are skipped
+} Tournament;
+
+static u64 now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000ull + now.tv_nsec / 1000000;
+}
+
+static f64 score_to_elo(f64 score) {
+    return -400.0 * log10(1.0 / score - 1.0);
+}
+
+static f64 elo_to_score(f64 elo) {
+    return 1.0 / (1.0 + pow(10.0, -elo / 400.0));
+}
+
+typedef struct {
+    f64 elo;
+    f64 margin;  // 95% confidence
+    f64 llr;     // Log-likelihood ratio of H1 against H0
+} Statistics;
+
+// Normal approximation of the trinomial results, like most testing frameworks
+static Statistics compute_statistics(const Tournament* tournament) {
+    const u64* outcomes = tournament->outcomes;
+    const f64 nb_games = outcomes[A_WINS] + outcomes[DRAW] + outcomes[B_WINS];
+    Statistics statistics = {0};
+    if (nb_games == 0) return statistics;
+
+    // Half a game either way keeps the logs finite on one-sided results
+    const f64 wins = outcomes[A_WINS] ? outcomes[A_WINS] : 0.5;
+    const f64 losses = outcomes[B_WINS] ? outcomes[B_WINS] : 0.5;
+    const f64 total = wins + outcomes[DRAW] + losses;
+    const f64 score = (wins + outcomes[DRAW] / 2.0) / total;
+    const f64 variance = (wins + outcomes[DRAW] / 4.0) / total - score * score;
+    const f64 deviation = sqrt(variance / total);
+
+    const f64 low = score - 1.96 * deviation;
+    const f64 high = score + 1.96 * deviation;
+    statistics.elo = score_to_elo(score);
+    statistics.margin = (score_to_elo(high < 1.0 ? high : 0.9999) - score_to_elo(low > 0.0 ? low : 0.0001)) / 2.0;
+
+    const f64 score0 = elo_to_score(tournament->elo0);
+    const f64 score1 = elo_to_score(tournament->elo1);
+    if (variance > 0.0) statistics.llr = total * (score1 - score0) * (2.0 * score - score0 - score1) / (2.0 * variance);
+    return statistics;
+}
+
+static f64 lower_bound(const Tournament* tournament) { return log(tournament->beta / (1.0 - tournament->alpha)); }
+static f64 upper_bound(const Tournament* tournament) { return log((1.0 - tournament->beta) / tournament->alpha); }
+
+static void log_progress(const Tournament* tournament) {
+    const u64* outcomes = tournament->outcomes;
+    const Statistics statistics = compute_statistics(tournament);
+    printf("games %lu: +%lu =%lu -%lu  elo %+.1f +- %.1f  LLR %.2f [%.2f, %.2f]\n",
+        outcomes[A_WINS] + outcomes[DRAW] + outcomes[B_WINS], outcomes[A_WINS], outcomes[DRAW], outcomes[B_WINS],
+        statistics.elo, statistics.margin, statistics.llr, lower_bound(tournament), upper_bound(tournament));
+    fflush(stdout);
+}
+
+static bool engine_send(EngineProcess* engine, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    const bool ok = vdprintf(engine->input, format, args) >= 0 && write(engine->input, "\n", 1) == 1;
+    va_end(args);
+    return ok;
+}
+
+// False on timeout or once the engine is gone. Overlong lines are cut.
+static bool engine_read_line(EngineProcess* engine, char* line, size_t size, u64 deadline_ms) {
+    while (true) {
+        char* start = engine->buffer + engine->buffer_start;
+        const size_t available = engine->buffer_end - engine->buffer_start;
+        char* newline = memchr(start, '\n', available);
+        const bool full = engine->buffer_start == 0 && engine->buffer_end == sizeof(engine->buffer);
+        if (newline != NULL || full) {
+            const size_t length = newline ? (size_t) (newline - start) : available;
+            const size_t copied = length < size - 1 ? length : size - 1;
+            memcpy(line, start, copied);
+            line[copied] = '\0';
+            if (copied && line[copied - 1] == '\r') line[copied - 1] = '\0';
+            engine->buffer_start += newline ? length + 1 : length;
+            return true;
+        }
+
+        // Room for more at the end of the buffer
+        memmove(engine->buffer, start, available);
+        engine->buffer_start = 0;
+        engine->buffer_end = available;
+
+        const u64 now = now_ms();
+        if (now >= deadline_ms) return false;
+        struct pollfd poll_fd = { .fd = engine->output, .events = POLLIN };
+        const int ready = poll(&poll_fd, 1, deadline_ms - now);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return false;
+
+        const ssize_t nb_read = read(engine->output, engine->buffer + engine->buffer_end, sizeof(engine->buffer) - engine->buffer_end);
+        if (nb_read < 0 && errno == EINTR) continue;
+        if (nb_read <= 0) return false;
+        engine->buffer_end += nb_read;
+    }
+}
+
+// Skips the lines before the one starting with `prefix`
+static bool engine_wait_for(EngineProcess* engine, const char* prefix, char* line, size_t size, u64 deadline_ms) {
+    const size_t prefix_length = strlen(prefix);
+    while (engine_read_line(engine, line, size, deadline_ms)) {
+        if (!strncmp(line, prefix, prefix_length) && (line[prefix_length] == ' ' || line[prefix_length] == '\0'))
+            return true;
+    }
+    return false;
+}
+
+static bool engine_is_ready(EngineProcess* engine) {
+    char line[256];
+    return engine_send(engine, "isready") && engine_wait_for(engine, "readyok", line, sizeof(line), now_ms() + HANDSHAKE_TIMEOUT_MS);
+}
+
+static void engine_stop(EngineProcess* engine) {
+    if (engine->pid == 0) return;
+
+    // A stuck engine wouldn't read `quit`
+    engine_send(engine, "quit");
+    close(engine->input);
+    close(engine->output);
+    for (int i = 0; i < 100 && waitpid(engine->pid, NULL, WNOHANG) == 0; i++) usleep(10000);
+    if (waitpid(engine->pid, NULL, WNOHANG) == 0) {
+        kill(engine->pid, SIGKILL);
+        waitpid(engine->pid, NULL, 0);
+    }
+    engine->pid = 0;
+}
+
+// Pipes are made close on exec under this lock, so that an engine started by
+// another seat at the same time doesn't inherit them
+static pthread_mutex_t spawn_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool spawn_engine(EngineProcess* engine, const char* path) {
+    int to_engine[2], from_engine[2];
+    if (pipe(to_engine) < 0) return false;
+    if (pipe(from_engine) < 0) {
+        close(to_engine[0]);
+        close(to_engine[1]);
+        return false;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(to_engine[i], F_SETFD, FD_CLOEXEC);
+        fcntl(from_engine[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, to_engine[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, from_engine[1], STDOUT_FILENO);
+    char* argv[] = { (char*) path, NULL };
+    const bool spawned = posix_spawn(&engine->pid, path, &actions, NULL, argv, environ) == 0;
+    posix_spawn_file_actions_destroy(&actions);
+
+    close(to_engine[0]);
+    close(from_engine[1]);
+    engine->input = to_engine[1];
+    engine->output = from_engine[0];
+    if (!spawned) {
+        close(engine->input);
+        close(engine->output);
+        engine->pid = 0;
+    }
+    return spawned;
+}
+
+static bool engine_start(EngineProcess* engine, const EngineConfig* config) {
+    *engine = (EngineProcess) {0};
+    pthread_mutex_lock(&spawn_lock);
+    const bool spawned = spawn_engine(engine, config->path);
+    pthread_mutex_unlock(&spawn_lock);
+    if (!spawned) return false;
+
+    char line[256];
+    bool ok = engine_send(engine, "uci") && engine_wait_for(engine, "uciok", line, sizeof(line), now_ms() + HANDSHAKE_TIMEOUT_MS);
+    if (ok) ok = engine_send(engine, "setoption name Hash value %zu", config->hash_mb);
+    if (ok && config->eval_path) ok = engine_send(engine, "setoption name EvalFile value %s", config->eval_path);
+    if (ok) ok = engine_is_ready(engine);
+    if (!ok) engine_stop(engine);
+    return ok;
+}
+
+static bool append_move(Seat* seat, size_t* length, const char* move) {
+    const size_t move_length = strlen(move);
+    if (*length + move_length + 2 > seat->moves_capacity) {
+        const size_t capacity = seat->moves_capacity ? seat->moves_capacity * 2 : 4096;
+        char* moves = realloc(seat->moves, capacity);
+        if (moves == NULL) return false;
+        seat->moves = moves;
+        seat->moves_capacity = capacity;
+    }
+    seat->moves[(*length)++] = ' ';
+    memcpy(seat->moves + *length, move, move_length + 1);
+    *length += move_length;
+    return true;
+}
+
+static bool side_to_play_in_check(const GameState* state) {
+    const PieceColor color = state->color_to_play;
+    return attacked_squares(&state->attacks, color ^ 1) & state->bitboards.pieces[color][KING];
+}
+
+// Returns the winner's color, or -1 for a draw. An engine that stops answering
+// loses, and is started again for the next game.
+static i8 play_game(const Tournament* tournament, Seat* seat, const PackedPosition* opening, u8 white_engine, GameEnd* end) {
+    GameState* state = seat->state;
+    unpack_position(opening, state);
+    char opening_fen[MAX_FEN_LENGTH];
+    write_fen(state, opening_fen);
+
+    for (u8 engine = 0; engine < 2; engine++) {
+        EngineProcess* process = &seat->engines[engine];
+        if (process->pid == 0) engine_start(process, &tournament->engines[engine]);
+        if (process->pid == 0 || !engine_send(process, "ucinewgame") || !engine_is_ready(process)) {
+            engine_stop(process);
+            *end = END_DISCONNECT;
+            return engine == white_engine ? BLACK : WHITE;
+        }
+    }
+
+    i64 clocks[2] = { tournament->time_ms, tournament->time_ms };  // [PieceColor]
+    size_t moves_length = 0;
+    while (true) {
+        Move moves[MAX_MOVES];
+        if (generate_legal_moves(state, moves) == 0) {
+            *end = side_to_play_in_check(state) ? END_MATE : END_STALEMATE;
+            return *end == END_MATE ? state->color_to_play ^ 1 : -1;
+        }
+        if (count_repetitions(state) >= 2) {
+            *end = END_REPETITION;
+            return -1;
+        }
+        if (state->halfmove_clock >= 100) {
+            *end = END_FIFTY_MOVES;
+            return -1;
+        }
+
+        const PieceColor color = state->color_to_play;
+        const u8 engine = color == WHITE ? white_engine : white_engine ^ 1;
+        EngineProcess* process = &seat->engines[engine];
+        const u64 nodes = tournament->engines[engine].nodes;
+        char nodes_limit[32] = "";
+        if (nodes) snprintf(nodes_limit, sizeof(nodes_limit), " nodes %lu", nodes);
+
+        const u64 start_ms = now_ms();
+        char line[1024];
+        bool answered = engine_send(process, "position fen %s%s%s", opening_fen, moves_length ? " moves" : "", moves_length ? seat->moves : "");
+        answered = answered && engine_send(process, "go wtime %ld btime %ld winc %u binc %u%s",
+            clocks[WHITE] > 0 ? clocks[WHITE] : 1, clocks[BLACK] > 0 ? clocks[BLACK] : 1,
+            tournament->increment_ms, tournament->increment_ms, nodes_limit);
+        answered = answered && engine_wait_for(process, "bestmove", line, sizeof(line), start_ms + clocks[color] + MOVE_TIMEOUT_MARGIN_MS);
+        clocks[color] -= now_ms() - start_ms;
+
+        if (!answered) {
+            // Either dead or still searching, both need a new process
+            engine_stop(process);
+            *end = clocks[color] <= 0 ? END_TIME : END_DISCONNECT;
+            return color ^ 1;
+        }
+        if (clocks[color] <= 0) {
+            *end = END_TIME;
+            return color ^ 1;
+        }
+
+        char move_text[UCI_MOVE_LENGTH] = "";
+        sscanf(line, "bestmove %5s", move_text);
+        Move move;
+        if (!parse_uci_move(state, move_text, &move) || !append_move(seat, &moves_length, move_text)) {
+            *end = END_ILLEGAL_MOVE;
+            return color ^ 1;
+        }
+        clocks[color] += tournament->increment_ms;
+        make_move(state, move);
+    }
+}
+
+static void game_task(void* context, u16 thread_index, size_t task) {
+    Tournament* tournament = context;
+    if (__atomic_load_n(&tournament->finished, __ATOMIC_RELAXED)) return;
+
+    // Both colors for each opening, A takes white first
+    const PackedPosition* opening = &tournament->openings[task / 2 % tournament->nb_openings];
+    const u8 white_engine = task % 2;
+    GameEnd end;
+    const i8 winner = play_game(tournament, &tournament->seats[thread_index], opening, white_engine, &end);
+
+    GameOutcome outcome = DRAW;
+    if (winner >= 0) outcome = (winner == WHITE) == (white_engine == 0) ? A_WINS : B_WINS;
+
+    pthread_mutex_lock(&tournament->lock);
+    if (!tournament->finished) {
+        tournament->outcomes[outcome]++;
+        tournament->ends[end]++;
+
+        const u64 nb_games = tournament->outcomes[A_WINS] + tournament->outcomes[DRAW] + tournament->outcomes[B_WINS];
+        const Statistics statistics = compute_statistics(tournament);
+        const bool decided = statistics.llr <= lower_bound(tournament) || statistics.llr >= upper_bound(tournament);
+        if (decided) __atomic_store_n(&tournament->finished, true, __ATOMIC_RELAXED);
+        if (!decided && nb_games % 100 == 0 && nb_games < tournament->nb_games) log_progress(tournament);
+    }
+    pthread_mutex_unlock(&tournament->lock);
+}
+
+static void add_opening(void* user_data, u16 thread_index, u64 line_offset,
+                        const GameState* state, const char* operations, size_t operations_length) {
+    (void) thread_index;
+    (void) line_offset;
+    (void) operations;
+    (void) operations_length;
+    Tournament* tournament = user_data;
+    if (tournament->nb_openings == tournament->openings_capacity) {
+        const size_t capacity = tournament->openings_capacity ? tournament->openings_capacity * 2 : 256;
+        PackedPosition* openings = realloc(tournament->openings, capacity * sizeof(PackedPosition));
+        if (openings == NULL) return;
+        tournament->openings = openings;
+        tournament->openings_capacity = capacity;
+    }
+    pack_position(state, &tournament->openings[tournament->nb_openings++]);
+}
+
+static bool load_openings(Tournament* tournament, const char* path) {
+    if (path) {
+        // One reading thread, the callback isn't locked
+        EpdStats stats;
+        if (!read_epd_file(path, 1, add_opening, tournament, &stats)) return false;
+        if (stats.nb_invalid) fprintf(stderr, "%lu invalid positions skipped in %s\n", stats.nb_invalid, path);
+        return tournament->nb_openings > 0;
+    }
+
+    GameState* state = game_state_create();
+    if (state == NULL) return false;
+    add_opening(tournament, 0, 0, state, NULL, 0);
+    game_state_destroy(state);
+    return tournament->nb_openings > 0;
+}
+
+static bool create_seats(Tournament* tournament) {
+    tournament->seats = calloc(tournament->nb_threads, sizeof(Seat));
+    if (tournament->seats == NULL) return false;
+
+    for (u16 i = 0; i < tournament->nb_threads; i++) {
+        Seat* seat = &tournament->seats[i];
+        if ((seat->state = game_state_create()) == NULL) return false;
+        for (u8 engine = 0; engine < 2; engine++) {
+            const EngineConfig* config = &tournament->engines[engine];
+            if (!engine_start(&seat->engines[engine], config)) {
+                fprintf(stderr, "can't start %s as a UCI engine\n", config->path);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void destroy_tournament(Tournament* tournament) {
+    if (tournament->seats) {
+        for (u16 i = 0; i < tournament->nb_threads; i++) {
+            game_state_destroy(tournament->seats[i].state);
+            engine_stop(&tournament->seats[i].engines[0]);
+            engine_stop(&tournament->seats[i].engines[1]);
+            free(tournament->seats[i].moves);
+        }
+    }
+    free(tournament->seats);
+    free(tournament->openings);
+    pthread_mutex_destroy(&tournament->lock);
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+        "usage: %s --engine-a <path> --engine-b <path> [options]\n"
+        "  --engine-a <path>      UCI engine under test\n"
+        "  --engine-b <path>      reference UCI engine\n"
+        "  --games <n>            games to play at most (default 1000)\n"
+        "  --openings <file.epd>  opening suite (default the starting position)\n"
+        "  --time <seconds>       per side and per game (default 10)\n"
+        "  --increment <seconds>  added after each move (default 0.1)\n"
+        "  --concurrency <n>      games played at once (default one per core)\n"
+        "  --hash <mb>            per engine process (default 16)\n"
+        "  --eval-a <file>        EvalFile option of the engine under test\n"
+        "  --eval-b <file>        EvalFile option of the reference engine\n"
+        "  --nodes-a <n>          node limit per move of the engine under test\n"
+        "  --nodes-b <n>          node limit per move of the reference engine\n"
+        "  --elo0 <elo>           SPRT null hypothesis (default 0)\n"
+        "  --elo1 <elo>           SPRT alternative hypothesis (default 5)\n"
+        "  --alpha <p>            SPRT false positive rate (default 0.05)\n"
+        "  --beta <p>             SPRT false negative rate (default 0.05)\n",
+        program);
+}
+
+int main(int argc, char** argv) {
+    Tournament tournament = {
+        .engines = { { .hash_mb = 16 }, { .hash_mb = 16 } },
+        .time_ms = 10000,
+        .increment_ms = 100,
+        .elo0 = 0.0,
+        .elo1 = 5.0,
+        .alpha = 0.05,
+        .beta = 0.05,
+        .nb_games = 1000,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+    };
+    const char* openings_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+        if (!strcmp(option, "--engine-a")) tournament.engines[0].path = value;
+        else if (!strcmp(option, "--engine-b")) tournament.engines[1].path = value;
+        else if (!strcmp(option, "--games")) tournament.nb_games = strtoull(value, NULL, 10);
+        else if (!strcmp(option, "--openings")) openings_path = value;
+        else if (!strcmp(option, "--time")) tournament.time_ms = atof(value) * 1000;
+        else if (!strcmp(option, "--increment")) tournament.increment_ms = atof(value) * 1000;
+        else if (!strcmp(option, "--concurrency")) tournament.nb_threads = atoi(value);
+        else if (!strcmp(option, "--hash")) tournament.engines[0].hash_mb = tournament.engines[1].hash_mb = atol(value);
+        else if (!strcmp(option, "--eval-a")) tournament.engines[0].eval_path = value;
+        else if (!strcmp(option, "--eval-b")) tournament.engines[1].eval_path = value;
+        else if (!strcmp(option, "--nodes-a")) tournament.engines[0].nodes = strtoull(value, NULL, 10);
+        else if (!strcmp(option, "--nodes-b")) tournament.engines[1].nodes = strtoull(value, NULL, 10);
+        else if (!strcmp(option, "--elo0")) tournament.elo0 = atof(value);
+        else if (!strcmp(option, "--elo1")) tournament.elo1 = atof(value);
+        else if (!strcmp(option, "--alpha")) tournament.alpha = atof(value);
+        else if (!strcmp(option, "--beta")) tournament.beta = atof(value);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (tournament.engines[0].path == NULL || tournament.engines[1].path == NULL
+            || tournament.nb_games == 0 || tournament.time_ms == 0 || tournament.elo0 >= tournament.elo1
+            || tournament.alpha <= 0.0 || tournament.alpha >= 1.0 || tournament.beta <= 0.0 || tournament.beta >= 1.0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (tournament.nb_threads == 0) tournament.nb_threads = default_thread_count();
+    if (tournament.nb_threads > MAX_POOL_THREADS) tournament.nb_threads = MAX_POOL_THREADS;
+
+    // A dead engine is handled where it's written to, not by the signal
+    signal(SIGPIPE, SIG_IGN);
+
+    int status = 1;
+    if (!load_openings(&tournament, openings_path)) {
+        fprintf(stderr, "no openings in %s\n", openings_path ? openings_path : "the starting position");
+        goto error;
+    }
+    if (!create_seats(&tournament)) {
+        fprintf(stderr, "can't set up %u game seats\n", tournament.nb_threads);
+        goto error;
+    }
+
+    printf("A: %s, B: %s\n", tournament.engines[0].path, tournament.engines[1].path);
+    printf("%zu games, %zu openings, %u at once, %.1fs+%.2fs\n", tournament.nb_games, tournament.nb_openings,
+        tournament.nb_threads, tournament.time_ms / 1000.0, tournament.increment_ms / 1000.0);
+    parallel_for(tournament.nb_games, tournament.nb_threads, game_task, &tournament);
+
+    log_progress(&tournament);
+    for (GameEnd end = 0; end < END_COUNT; end++) printf("%s: %lu  ", end_names[end], tournament.ends[end]);
+    printf("\n");
+
+    const u64* outcomes = tournament.outcomes;
+    const f64 llr = compute_statistics(&tournament).llr;
+    if (llr >= upper_bound(&tournament)) printf("SPRT: H1 accepted, A is stronger by %+.1f elo or more\n", tournament.elo1);
+    else if (llr <= lower_bound(&tournament)) printf("SPRT: H0 accepted, A isn't stronger by %+.1f elo\n", tournament.elo1);
+    else printf("SPRT: inconclusive after %lu games\n", outcomes[A_WINS] + outcomes[DRAW] + outcomes[B_WINS]);
+    status = 0;
+
+error:
+    destroy_tournament(&tournament);
+    return status;
+}
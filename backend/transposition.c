@@ -0,0 +1,138 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "transposition.h"
+
+// Data layout: move (32 bits), score (16), depth (8), bound (2), generation (6)
+#define GENERATION_MASK 0x3F
+
+static u64 pack(TTData data, u8 generation) {
+    u32 move;
+    memcpy(&move, &data.move, sizeof(move));
+    return (u64) move
+        | (u64) (u16) data.score << 32
+        | (u64) data.depth << 48
+        | (u64) data.bound << 56
+        | (u64) (generation & GENERATION_MASK) << 58;
+}
+
+static TTData unpack(u64 data) {
+    TTData output = {
+        .score = (i16) (data >> 32),
+        .depth = data >> 48,
+        .bound = (data >> 56) & 3,
+    };
+    const u32 move = (u32) data;
+    memcpy(&output.move, &move, sizeof(move));
+    return output;
+}
+
+static inline u8 data_generation(u64 data) { return data >> 58; }
+
+// Relaxed atomics: no ordering is needed, the xor check catches torn entries.
+// They only keep each 64-bit load and store in one piece.
+static inline void load_entry(const TTEntry* entry, u64* key, u64* data) {
+    *key = __atomic_load_n(&entry->key, __ATOMIC_RELAXED);
+    *data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+}
+
+static inline void store_entry(TTEntry* entry, u64 key, u64 data) {
+    __atomic_store_n(&entry->key, key, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
+
+TranspositionTable* tt_create(size_t size_mb) {
+    TranspositionTable* tt = malloc(sizeof(TranspositionTable));
+    if (tt == NULL) return NULL;
+
+    tt->nb_buckets = (size_mb << 20) / sizeof(TTBucket);
+    if (tt->nb_buckets == 0) tt->nb_buckets = 1;
+    tt->buckets = aligned_alloc(alignof(TTBucket), tt->nb_buckets * sizeof(TTBucket));
+    if (tt->buckets == NULL) {
+        free(tt);
+        return NULL;
+    }
+
+    tt_clear(tt);
+    return tt;
+}
+
+void tt_destroy(TranspositionTable* tt) {
+    if (tt == NULL) return;
+    free(tt->buckets);
+    free(tt);
+}
+
+void tt_clear(TranspositionTable* tt) {
+    memset(tt->buckets, 0, tt->nb_buckets * sizeof(TTBucket));
+    tt->generation = 0;
+}
+
+void tt_new_search(TranspositionTable* tt) {
+    tt->generation = (tt->generation + 1) & GENERATION_MASK;
+}
+
+bool tt_probe(const TranspositionTable* tt, u64 hash, TTData* output) {
+    const TTBucket* bucket = tt_bucket(tt, hash);
+    for (size_t i = 0; i < TT_BUCKET_SIZE; i++) {
+        u64 key, data;
+        load_entry(&bucket->entries[i], &key, &data);
+        if ((key ^ data) != hash || data == 0) continue;
+
+        *output = unpack(data);
+        return true;
+    }
+    return false;
+}
+
+void tt_store(TranspositionTable* tt, u64 hash, TTData data) {
+    TTBucket* bucket = tt_bucket(tt, hash);
+
+    // Same position if it's already there, otherwise the least useful entry:
+    // shallow ones, and the ones left by older searches.
+    TTEntry* replaced = NULL;
+    u64 replaced_data = 0;
+    bool same_position = false;
+    i32 worst_value = INT32_MAX;
+    for (size_t i = 0; i < TT_BUCKET_SIZE; i++) {
+        u64 key, entry_data;
+        load_entry(&bucket->entries[i], &key, &entry_data);
+
+        if ((key ^ entry_data) == hash) {
+            replaced = &bucket->entries[i];
+            replaced_data = entry_data;
+            same_position = true;
+            break;
+        }
+
+        const u8 age = (tt->generation - data_generation(entry_data)) & GENERATION_MASK;
+        const i32 value = (i32) unpack(entry_data).depth - 8 * age;
+        if (value < worst_value) {
+            worst_value = value;
+            replaced = &bucket->entries[i];
+            replaced_data = entry_data;
+        }
+    }
+
+    // Don't lose the best move of a position just because this search didn't find one
+    if (data.move.start == data.move.end && same_position)
+        data.move = unpack(replaced_data).move;
+
+    const u64 new_data = pack(data, tt->generation);
+    store_entry(replaced, hash ^ new_data, new_data);
+}
+
+// Permille of the first thousand buckets' entries written by the current
+// search, what UCI calls `hashfull`
+u16 tt_hashfull(const TranspositionTable* tt) {
+    const size_t nb_buckets = tt->nb_buckets < 1000 ? tt->nb_buckets : 1000;
+    size_t nb_used = 0;
+    for (size_t i = 0; i < nb_buckets; i++) {
+        for (size_t j = 0; j < TT_BUCKET_SIZE; j++) {
+            u64 key, data;
+            load_entry(&tt->buckets[i].entries[j], &key, &data);
+            if (data != 0 && data_generation(data) == tt->generation) nb_used++;
+        }
+    }
+    return nb_used * 1000 / (nb_buckets * TT_BUCKET_SIZE);
+}
@@ -0,0 +1,57 @@
+// vim:ft=c
+#pragma once
+
+#include <stdalign.h>
+
+#include "lib.h"
+
+typedef enum: u8 { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT } Bound;
+
+// What a search wants back about a position it already looked at. A move with
+// `start == end` means there is none.
+typedef struct {
+    Move move;
+    i16 score;
+    u8 depth;
+    Bound bound;
+} TTData;
+
+// Written and read by many threads without any lock: `key` is the position hash
+// xored with `data`, so an entry torn by two concurrent writes doesn't verify
+// and is just a miss.
+typedef struct {
+    u64 key;
+    u64 data;
+} TTEntry;
+
+#define TT_BUCKET_SIZE 4
+
+// One cache line, so a probe costs at most one cache miss
+typedef struct {
+    alignas(64) TTEntry entries[TT_BUCKET_SIZE];
+} TTBucket;
+
+typedef struct {
+    TTBucket* buckets;
+    size_t nb_buckets;
+    u8 generation;  // Bumped by every new search, entries from older ones get replaced first
+} TranspositionTable;
+
+TranspositionTable* tt_create(size_t size_mb);
+void tt_destroy(TranspositionTable* tt);
+void tt_clear(TranspositionTable* tt);
+void tt_new_search(TranspositionTable* tt);
+
+bool tt_probe(const TranspositionTable* tt, u64 hash, TTData* output);
+void tt_store(TranspositionTable* tt, u64 hash, TTData data);
+u16 tt_hashfull(const TranspositionTable* tt);
+
+static inline TTBucket* tt_bucket(const TranspositionTable* tt, u64 hash) {
+    // Maps the hash onto [0, nb_buckets) without needing a power of two
+    return &tt->buckets[((unsigned __int128) hash * tt->nb_buckets) >> 64];
+}
+
+// Lets the search start loading the bucket while it still generates moves
+static inline void tt_prefetch(const TranspositionTable* tt, u64 hash) {
+    __builtin_prefetch(tt_bucket(tt, hash));
+}
@@ -0,0 +1,382 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "lib.h"
+#include "book.h"
+#include "fen.h"
+#include "search.h"
+
+#define ENGINE_NAME "chess"
+#define DEFAULT_HASH_MB 64
+#define MAX_HASH_MB 65536
+
+// The main thread reads the commands, searches run on their own thread so
+// that `stop`, `ponderhit` and `isready` are answered right away.
+typedef struct {
+    Searcher* searcher;
+    Tablebases* tablebases;
+    NnueNetwork* network;
+    OpeningBook* book;  // Book positions are answered without searching
+    u64 book_seed;
+
+    GameState* state;  // Set by `position`, searches work on a copy
+    GameState* search_state;
+    bool invalid_position;  // The last `position` was refused, `go` has nothing to search
+    SearchLimits limits;
+
+    pthread_t search_thread;
+    bool searching;
+
+    // A `go infinite` or `go ponder` search doesn't print its move before
+    // being told to
+    pthread_mutex_t lock;
+    pthread_cond_t released;
+    bool infinite;
+    bool released_flag;
+
+    pthread_mutex_t output_lock;
+} Engine;
+
+// One line at a time, the search thread prints too
+static void send(Engine* engine, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    pthread_mutex_lock(&engine->output_lock);
+    vprintf(format, args);
+    putchar('\n');
+    fflush(stdout);
+    pthread_mutex_unlock(&engine->output_lock);
+    va_end(args);
+}
+
+static void send_info(const SearchResult* result, void* context) {
+    Engine* engine = context;
+    char score[32];
+    if (result->score >= MATE_BOUND) snprintf(score, sizeof(score), "mate %d", (MATE_SCORE - result->score + 1) / 2);
+    else if (result->score <= -MATE_BOUND) snprintf(score, sizeof(score), "mate -%d", (MATE_SCORE + result->score) / 2);
+    else snprintf(score, sizeof(score), "cp %d", result->score);
+
+    char pv[MAX_PLY * UCI_MOVE_LENGTH + 1] = "";
+    size_t length = 0;
+    for (u8 i = 0; i < result->pv_length; i++) {
+        pv[length++] = ' ';
+        format_uci_move(result->pv[i], pv + length);
+        length += strlen(pv + length);
+    }
+
+    const u64 nps = result->elapsed_ms ? result->nodes * 1000 / result->elapsed_ms : 0;
+    send(engine, "info depth %u score %s nodes %lu nps %lu time %u pv%s",
+        result->depth, score, result->nodes, nps, result->elapsed_ms, pv);
+}
+
+static void* search_thread_main(void* arg) {
+    Engine* engine = arg;
+    SearchResult* result = malloc(sizeof(SearchResult));
+    if (result == NULL) {
+        send(engine, "bestmove 0000");
+        return NULL;
+    }
+    search_best_move(engine->searcher, engine->search_state, &engine->limits, result);
+
+    // The search may end on its own while pondering, the move still waits
+    pthread_mutex_lock(&engine->lock);
+    while (!engine->released_flag && (engine->infinite || __atomic_load_n(&engine->limits.ponder, __ATOMIC_ACQUIRE)))
+        pthread_cond_wait(&engine->released, &engine->lock);
+    pthread_mutex_unlock(&engine->lock);
+
+    char best_move[UCI_MOVE_LENGTH] = "0000";
+    char ponder_move[UCI_MOVE_LENGTH];
+    if (result->best_move.start != result->best_move.end) format_uci_move(result->best_move, best_move);
+    if (result->pv_length >= 2) {
+        format_uci_move(result->pv[1], ponder_move);
+        send(engine, "bestmove %s ponder %s", best_move, ponder_move);
+    } else {
+        send(engine, "bestmove %s", best_move);
+    }
+    free(result);
+    return NULL;
+}
+
+// Lets a waiting search print its move
+static void release_search(Engine* engine) {
+    pthread_mutex_lock(&engine->lock);
+    engine->released_flag = true;
+    pthread_cond_signal(&engine->released);
+    pthread_mutex_unlock(&engine->lock);
+}
+
+static void stop_search(Engine* engine) {
+    if (!engine->searching) return;
+    search_stop(engine->searcher);
+    release_search(engine);
+    pthread_join(engine->search_thread, NULL);
+    engine->searching = false;
+}
+
+static void handle_go(Engine* engine, char** tokens) {
+    stop_search(engine);
+    if (engine->invalid_position) {
+        send(engine, "bestmove 0000");
+        return;
+    }
+    engine->limits = (SearchLimits) {0};
+    engine->infinite = false;
+    engine->released_flag = false;
+
+    SearchLimits* limits = &engine->limits;
+    for (char** token = tokens; *token; token++) {
+        if (!strcmp(*token, "infinite")) {
+            engine->infinite = true;
+            continue;
+        }
+        if (!strcmp(*token, "ponder")) {
+            limits->ponder = true;
+            continue;
+        }
+
+        // Everything else takes a value. A clock at 0 would mean no limit.
+        if (token[1] == NULL) break;
+        const long value = atol(token[1]) > 0 ? atol(token[1]) : 0;
+        if (!strcmp(*token, "depth")) limits->depth = value < MAX_PLY ? value : MAX_PLY - 1;
+        else if (!strcmp(*token, "nodes")) limits->nodes = strtoull(token[1], NULL, 10);
+        else if (!strcmp(*token, "movetime")) limits->move_time_ms = value ? value : 1;
+        else if (!strcmp(*token, "wtime")) limits->time_left_ms[WHITE] = value ? value : 1;
+        else if (!strcmp(*token, "btime")) limits->time_left_ms[BLACK] = value ? value : 1;
+        else if (!strcmp(*token, "winc")) limits->increment_ms[WHITE] = value;
+        else if (!strcmp(*token, "binc")) limits->increment_ms[BLACK] = value;
+        else if (!strcmp(*token, "movestogo")) limits->moves_to_go = value;
+        else continue;
+        token++;
+    }
+
+    // Not while pondering or analysing, the GUI waits for its own signal
+    Move book_move;
+    if (engine->book && !engine->infinite && !limits->ponder
+            && pick_book_move(engine->book, engine->state, random_u64(&engine->book_seed), &book_move)) {
+        char move[UCI_MOVE_LENGTH];
+        format_uci_move(book_move, move);
+        send(engine, "bestmove %s", move);
+        return;
+    }
+
+    *engine->search_state = *engine->state;
+    search_clear_stop(engine->searcher);
+    engine->searching = pthread_create(&engine->search_thread, NULL, search_thread_main, engine) == 0;
+    if (!engine->searching) send(engine, "bestmove 0000");
+}
+
+// position [startpos | fen <fen>] [moves <move>...]
+static void handle_position(Engine* engine, char** tokens) {
+    stop_search(engine);
+    char fen[MAX_FEN_LENGTH] = STARTING_FEN;
+    char** token = tokens;
+
+    if (*token && !strcmp(*token, "fen")) {
+        size_t length = 0;
+        fen[0] = '\0';
+        for (token++; *token && strcmp(*token, "moves"); token++) {
+            const size_t token_length = strlen(*token);
+            if (length + token_length + 2 > MAX_FEN_LENGTH) continue;  // Invalid anyway
+            if (length) fen[length++] = ' ';
+            memcpy(fen + length, *token, token_length + 1);
+            length += token_length;
+        }
+    } else if (*token && !strcmp(*token, "startpos")) {
+        token++;
+    }
+
+    // Searching whatever is left would answer for a position the GUI never
+    // asked about
+    engine->invalid_position = true;
+    if (!load_fen(engine->state, fen)) {
+        send(engine, "info string invalid FEN: %s", fen);
+        load_fen(engine->state, STARTING_FEN);
+        return;
+    }
+
+    if (*token && !strcmp(*token, "moves")) {
+        for (token++; *token; token++) {
+            Move move;
+            if (!parse_uci_move(engine->state, *token, &move)) {
+                send(engine, "info string illegal move: %s", *token);
+                load_fen(engine->state, STARTING_FEN);
+                return;
+            }
+            make_move(engine->state, move);
+        }
+    }
+    engine->invalid_position = false;
+}
+
+static void apply_settings(Engine* engine) {
+    searcher_set_tablebases(engine->searcher, engine->tablebases);
+    searcher_set_network(engine->searcher, engine->network);
+    searcher_set_info_callback(engine->searcher, send_info, engine);
+}
+
+// setoption name <name> [value <value>], names can have spaces
+static void handle_setoption(Engine* engine, char** tokens) {
+    stop_search(engine);
+    char name[64] = "";
+    const char* value = "";
+    size_t length = 0;
+
+    char** token = tokens;
+    if (*token && !strcmp(*token, "name")) token++;
+    for (; *token && strcmp(*token, "value"); token++) {
+        const int written = snprintf(name + length, sizeof(name) - length, "%s%s", length ? " " : "", *token);
+        if (written > 0) length += written;
+        if (length >= sizeof(name)) length = sizeof(name) - 1;
+    }
+    if (*token && token[1]) value = token[1];
+
+    if (!strcasecmp(name, "Hash")) {
+        const long hash_mb = atol(value);
+        Searcher* searcher = searcher_create(hash_mb < 1 ? 1 : hash_mb > MAX_HASH_MB ? MAX_HASH_MB : hash_mb);
+        if (searcher == NULL) {
+            send(engine, "info string can't allocate %ld MB", hash_mb);
+            return;
+        }
+        searcher_set_threads(searcher, engine->searcher->nb_threads);
+        searcher_destroy(engine->searcher);
+        engine->searcher = searcher;
+        apply_settings(engine);
+    } else if (!strcasecmp(name, "Threads")) {
+        searcher_set_threads(engine->searcher, atoi(value));
+    } else if (!strcasecmp(name, "EvalFile")) {
+        nnue_destroy(engine->network);
+        engine->network = *value ? nnue_load(value) : NULL;
+        if (*value && engine->network == NULL) send(engine, "info string can't load network %s", value);
+        apply_settings(engine);
+    } else if (!strcasecmp(name, "BookFile")) {
+        book_close(engine->book);
+        engine->book = *value ? book_open(value) : NULL;
+        if (*value && engine->book == NULL) send(engine, "info string can't open book %s", value);
+    } else if (!strcasecmp(name, "TablebasePath")) {
+        tablebases_destroy(engine->tablebases);
+        engine->tablebases = tablebases_create();
+        if (*value && engine->tablebases && !tablebases_load_directory(engine->tablebases, value))
+            send(engine, "info string can't load tablebases from %s", value);
+        apply_settings(engine);
+    } else if (strcasecmp(name, "Ponder")) {
+        // Ponder only tells whether the GUI will send `go ponder`
+        send(engine, "info string unknown option: %s", name);
+    }
+}
+
+// Splits `line` in place, the array ends with NULL
+static size_t split_tokens(char* line, char** tokens, size_t max_tokens) {
+    size_t nb_tokens = 0;
+    char* save;
+    for (char* token = strtok_r(line, " \t\r\n", &save); token && nb_tokens < max_tokens - 1; token = strtok_r(NULL, " \t\r\n", &save))
+        tokens[nb_tokens++] = token;
+    tokens[nb_tokens] = NULL;
+    return nb_tokens;
+}
+
+static Engine* engine_create(void) {
+    Engine* engine = calloc(1, sizeof(Engine));
+    if (engine == NULL) return NULL;
+
+    engine->searcher = searcher_create(DEFAULT_HASH_MB);
+    engine->state = game_state_create();
+    engine->search_state = game_state_create();
+    if (engine->searcher == NULL || engine->state == NULL || engine->search_state == NULL) {
+        searcher_destroy(engine->searcher);
+        game_state_destroy(engine->state);
+        game_state_destroy(engine->search_state);
+        free(engine);
+        return NULL;
+    }
+
+    engine->book_seed = time(NULL) | 1;  // xorshift never leaves 0
+    pthread_mutex_init(&engine->lock, NULL);
+    pthread_cond_init(&engine->released, NULL);
+    pthread_mutex_init(&engine->output_lock, NULL);
+    apply_settings(engine);
+    return engine;
+}
+
+static void engine_destroy(Engine* engine) {
+    stop_search(engine);
+    searcher_destroy(engine->searcher);
+    game_state_destroy(engine->state);
+    game_state_destroy(engine->search_state);
+    tablebases_destroy(engine->tablebases);
+    nnue_destroy(engine->network);
+    book_close(engine->book);
+    pthread_mutex_destroy(&engine->lock);
+    pthread_cond_destroy(&engine->released);
+    pthread_mutex_destroy(&engine->output_lock);
+    free(engine);
+}
+
+int main(void) {
+    Engine* engine = engine_create();
+    if (engine == NULL) {
+        fprintf(stderr, "can't allocate the engine\n");
+        return 1;
+    }
+
+    // `position` lines grow with the game, getline keeps up
+    char* line = NULL;
+    size_t capacity = 0;
+    char** tokens = NULL;
+    size_t max_tokens = 0;
+
+    while (getline(&line, &capacity, stdin) >= 0) {
+        if (max_tokens < capacity / 2 + 2) {
+            max_tokens = capacity / 2 + 2;
+            char** grown = realloc(tokens, max_tokens * sizeof(char*));
+            if (grown == NULL) break;
+            tokens = grown;
+        }
+        if (split_tokens(line, tokens, max_tokens) == 0) continue;
+        const char* command = tokens[0];
+
+        if (!strcmp(command, "uci")) {
+            send(engine, "id name " ENGINE_NAME);
+            send(engine, "id author " ENGINE_NAME " contributors");
+            send(engine, "option name Hash type spin default %d min 1 max %d", DEFAULT_HASH_MB, MAX_HASH_MB);
+            send(engine, "option name Threads type spin default 1 min 1 max %d", MAX_SEARCH_THREADS);
+            send(engine, "option name Ponder type check default false");
+            send(engine, "option name EvalFile type string default <empty>");
+            send(engine, "option name TablebasePath type string default <empty>");
+            send(engine, "option name BookFile type string default <empty>");
+            send(engine, "uciok");
+        } else if (!strcmp(command, "isready")) {
+            send(engine, "readyok");
+        } else if (!strcmp(command, "ucinewgame")) {
+            stop_search(engine);
+            searcher_new_game(engine->searcher);
+        } else if (!strcmp(command, "position")) {
+            handle_position(engine, tokens + 1);
+        } else if (!strcmp(command, "go")) {
+            handle_go(engine, tokens + 1);
+        } else if (!strcmp(command, "stop")) {
+            stop_search(engine);
+        } else if (!strcmp(command, "ponderhit")) {
+            // The move is printed as soon as the search is done, like any other
+            search_ponderhit(&engine->limits);
+            pthread_mutex_lock(&engine->lock);
+            pthread_cond_signal(&engine->released);
+            pthread_mutex_unlock(&engine->lock);
+        } else if (!strcmp(command, "setoption")) {
+            handle_setoption(engine, tokens + 1);
+        } else if (!strcmp(command, "quit")) {
+            break;
+        } else {
+            send(engine, "info string unknown command: %s", command);
+        }
+    }
+
+    free(tokens);
+    free(line);
+    engine_destroy(engine);
+    return 0;
+}
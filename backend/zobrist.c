@@ -0,0 +1,21 @@
+#include "zobrist.h"
+
+u64 zobrist_pieces[2][6][64];
+u64 zobrist_castling[16];
+u64 zobrist_en_passant[8];
+u64 zobrist_black_to_play;
+
+__attribute__((constructor))
+static void init_zobrist(void) {
+    u64 seed = 0x2B0B2157C0FFEE11ull;
+
+    for (PieceColor color = WHITE; color <= BLACK; color++)
+        for (PiecesType type = PAWN; type <= KING; type++)
+            for (Square square = 0; square < 64; square++)
+                zobrist_pieces[color][type][square] = random_u64(&seed);
+
+    for (size_t i = 0; i < 16; i++) zobrist_castling[i] = random_u64(&seed);
+
+    for (size_t i = 0; i < 8; i++) zobrist_en_passant[i] = random_u64(&seed);
+    zobrist_black_to_play = random_u64(&seed);
+}
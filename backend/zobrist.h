@@ -0,0 +1,16 @@
+// vim:ft=c
+#pragma once
+
+#include "common_types.h"
+#include "bitboard.h"
+
+// A position's hash is the xor of the keys of everything in it. Xoring a key
+// twice cancels it, so moves can update the hash instead of recomputing it.
+extern u64 zobrist_pieces[2][6][64];  // [PieceColor][PiecesType][Square]
+extern u64 zobrist_castling[16];      // Indexed by the whole CastlingRights mask
+extern u64 zobrist_en_passant[8];     // Column of the en passant target
+extern u64 zobrist_black_to_play;
+
+static inline u64 zobrist_piece(Cell piece, Square square) {
+    return zobrist_pieces[piece.color][piece.type][square];
+}
@@ -1,5 +1,6 @@
 #!/bin/env python3
 import ctypes
+import random
 import tkinter as tk
 import threading
 
@@ -70,6 +71,36 @@ class Position(ctypes.Structure):
         return self.col == other.col and self.row == other.row
 
 
+class SquareChange(ctypes.Structure):
+    _fields_ = [("position", Position), ("piece", Cell)]
+
+
+class Move(ctypes.Structure):
+    CAPTURE, CASTLE, EN_PASSANT, PROMOTION = (1 << i for i in range(4))
+
+    _fields_ = [
+        ("start", ctypes.c_uint8),
+        ("end", ctypes.c_uint8),
+        ("promotion", ctypes.c_uint8),
+        ("flags", ctypes.c_uint8),
+    ]
+
+    @property
+    def start_position(self):
+        return Position(self.start % 8, self.start // 8)
+
+    @property
+    def end_position(self):
+        return Position(self.end % 8, self.end // 8)
+
+    def is_under_promotion(self):
+        return bool(self.flags & Move.PROMOTION) and self.promotion != PieceType.QWEEN.value
+
+
+class BookMove(ctypes.Structure):
+    _fields_ = [("move", Move), ("weight", ctypes.c_uint16)]
+
+
 class ChessBoard((Cell * 8) * 8):
     def get_piece_at(self, pos: Position):
         return LIBCHESS.get_piece_at(self, pos)
@@ -77,11 +108,6 @@ class ChessBoard((Cell * 8) * 8):
     def log(self):
         LIBCHESS.debug_log_chess_board(self)
 
-    def get_possible_moves(self, position):
-        moves_buffer = (Position * 24)()
-        nb_moves = LIBCHESS.get_possible_moves(self, position, moves_buffer)
-        return moves_buffer[:nb_moves]
-
     def find_cell(self, cell):
         return LIBCHESS.find_cell(self, cell)
 
@@ -120,12 +146,96 @@ class PlayedMoveStatus(ctypes.Structure):
 
 
 LIBCHESS = ctypes.CDLL(".build/libchess.so")
-LIBCHESS.get_main_chess_board.restype = ctypes.POINTER(ChessBoard)
+LIBCHESS.game_state_create.restype = ctypes.c_void_p
+LIBCHESS.get_chess_board.restype = ctypes.POINTER(ChessBoard)
 LIBCHESS.get_possible_moves.restype = ctypes.c_size_t
+LIBCHESS.generate_legal_moves.restype = ctypes.c_size_t
 LIBCHESS.get_color_to_play.restype = PieceColor
 LIBCHESS.get_piece_at.restype = Cell
 LIBCHESS.try_play_move.restype = PlayedMoveStatus
 LIBCHESS.find_cell.restype = Position
+LIBCHESS.load_fen.restype = ctypes.c_bool
+LIBCHESS.write_fen.restype = ctypes.c_size_t
+LIBCHESS.get_dirty_squares.restype = ctypes.c_uint64
+LIBCHESS.get_board_changes.restype = ctypes.c_size_t
+LIBCHESS.book_open.restype = ctypes.c_void_p
+LIBCHESS.get_book_moves.restype = ctypes.c_size_t
+LIBCHESS.pick_book_move.restype = ctypes.c_bool
+
+LIBCHESS.game_state_destroy.argtypes = [ctypes.c_void_p]
+LIBCHESS.get_chess_board.argtypes = [ctypes.c_void_p]
+LIBCHESS.get_color_to_play.argtypes = [ctypes.c_void_p]
+LIBCHESS.get_possible_moves.argtypes = [ctypes.c_void_p, Position, ctypes.POINTER(Position)]
+LIBCHESS.generate_legal_moves.argtypes = [ctypes.c_void_p, ctypes.POINTER(Move)]
+LIBCHESS.try_play_move.argtypes = [ctypes.c_void_p, Position, Position]
+LIBCHESS.load_fen.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+LIBCHESS.write_fen.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+LIBCHESS.get_dirty_squares.argtypes = [ctypes.c_void_p]
+LIBCHESS.get_board_changes.argtypes = [ctypes.c_void_p, ctypes.POINTER(SquareChange)]
+LIBCHESS.book_open.argtypes = [ctypes.c_char_p]
+LIBCHESS.book_close.argtypes = [ctypes.c_void_p]
+LIBCHESS.get_book_moves.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.POINTER(BookMove), ctypes.c_size_t]
+LIBCHESS.pick_book_move.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.POINTER(Move)]
+
+
+class GameState:
+    def __init__(self):
+        self.handle = LIBCHESS.game_state_create()
+
+    def __del__(self):
+        LIBCHESS.game_state_destroy(self.handle)
+
+    @property
+    def board(self) -> ChessBoard:
+        return LIBCHESS.get_chess_board(self.handle).contents
+
+    def get_color_to_play(self) -> PieceColor:
+        return LIBCHESS.get_color_to_play(self.handle)
+
+    def get_legal_moves(self):
+        moves_buffer = (Move * 256)()
+        nb_moves = LIBCHESS.generate_legal_moves(self.handle, moves_buffer)
+        return moves_buffer[:nb_moves]
+
+    def try_play_move(self, start, end):
+        return LIBCHESS.try_play_move(self.handle, start, end)
+
+    def get_board_changes(self) -> list[SquareChange]:
+        # Only the last move's squares, or all of them after a new position
+        changes_buffer = (SquareChange * 64)()
+        nb_changes = LIBCHESS.get_board_changes(self.handle, changes_buffer)
+        return changes_buffer[:nb_changes]
+
+    def load_fen(self, fen: str) -> bool:
+        return LIBCHESS.load_fen(self.handle, fen.encode())
+
+    @property
+    def fen(self) -> str:
+        fen_buffer = ctypes.create_string_buffer(100)
+        LIBCHESS.write_fen(self.handle, fen_buffer)
+        return fen_buffer.value.decode()
+
+
+class OpeningBook:
+    def __init__(self, path: str):
+        self.handle = LIBCHESS.book_open(path.encode())
+        if not self.handle:
+            raise OSError(f"Can't open book {path}")
+
+    def __del__(self):
+        if getattr(self, "handle", None):
+            LIBCHESS.book_close(self.handle)
+
+    def get_moves(self, game: GameState) -> list[BookMove]:
+        moves_buffer = (BookMove * 64)()
+        nb_moves = LIBCHESS.get_book_moves(self.handle, game.handle, moves_buffer, 64)
+        return moves_buffer[:nb_moves]
+
+    def pick_move(self, game: GameState) -> Optional[Move]:
+        move = Move()
+        if LIBCHESS.pick_book_move(self.handle, game.handle, random.getrandbits(64), ctypes.byref(move)):
+            return move
+        return None
 
 
 timer: Optional[threading.Timer] = None
@@ -151,13 +261,13 @@ def chrono(duree_noir, duree_blanc, board):
     texte_timer2['text']= str(round(duree_blanc, 2)) + "s"
 
     if duree_noir <= 0.0 or duree_blanc <= 0.0:
-        out_of_time_color = PieceColor(LIBCHESS.get_color_to_play())
+        out_of_time_color = board.game.get_color_to_play()
         opponent_color = out_of_time_color.get_opposite()
         board.show_message(f"{out_of_time_color} is out of time\n{opponent_color} wins")
         kill_timer()
         return
 
-    if LIBCHESS.get_color_to_play() == PieceColor.WHITE:
+    if board.game.get_color_to_play() == PieceColor.WHITE:
         timer = threading.Timer(0.1, chrono, [duree_noir, duree_blanc-0.1, board])
     else:
         timer = threading.Timer(0.1, chrono, [duree_noir-0.1, duree_blanc, board])
@@ -181,33 +291,45 @@ class ChessBoardWidget(tk.Canvas):
         super().__init__(parent, width=size, height=size)
 
         self.cell_size: int = size // 8
+        self.game = GameState()
+        self.legal_moves: list[Move] = self.game.get_legal_moves()
         self.possible_moves: list[Position] = []
         self.selected_cell: Optional[Position] = None
         self.Dpieces = Dpieces
 
-        # TODO: Render the pieces on the board
+        # Canvas items of the pieces, by (col, row). The squares never change,
+        # the pieces are only redrawn where the last move changed something.
+        self.piece_items: dict[tuple[int, int], int] = {}
+        self.draw_squares()
+        self.update_pieces()
         self.render()
 
         def on_click(event):
-            board = LIBCHESS.get_main_chess_board().contents
+            board = self.game.board
             clicked_cell = Position(event.x // self.cell_size, event.y // self.cell_size)
             piece_on_cell = board.get_piece_at(clicked_cell)
-            color_to_play = LIBCHESS.get_color_to_play()
+            color_to_play = self.game.get_color_to_play()
 
             if self.selected_cell is None or clicked_cell not in self.possible_moves:
                 if piece_on_cell.color != color_to_play.value:
                     return
-                self.possible_moves = board.get_possible_moves(clicked_cell)
+                # try_play_move always promotes to a qween
+                self.possible_moves = [
+                    move.end_position for move in self.legal_moves
+                    if move.start_position == clicked_cell and not move.is_under_promotion()
+                ]
                 self.selected_cell = clicked_cell
                 self.render()
                 return
 
 
             # TODO: Check the status and render it appropriately
-            move_status = LIBCHESS.try_play_move(board, self.selected_cell, clicked_cell)
+            move_status = self.game.try_play_move(self.selected_cell, clicked_cell)
 
+            self.legal_moves = self.game.get_legal_moves()
             self.possible_moves = []
             self.selected_cell = None
+            self.update_pieces()
             self.render()
 
             if move_status.your_king_in_check:
@@ -215,7 +337,7 @@ class ChessBoardWidget(tk.Canvas):
                 case = board.find_cell(Cell(color_to_play.value, PieceType.KING.value))
                 start_corner=(case.col * self.cell_size+taille,case.row * self.cell_size+taille)
                 end_corner=((case.col+1) * self.cell_size-taille,(case.row+1) * self.cell_size-taille)
-                self.create_oval(start_corner,end_corner,fill='red',outline='red')
+                self.create_oval(start_corner,end_corner,fill='red',outline='red',tags="overlay")
                 threading.Timer(0.5, self.render).start()
                 return
 
@@ -232,7 +354,7 @@ class ChessBoardWidget(tk.Canvas):
                     case = board.find_cell(Cell(color_to_play.get_opposite().value, PieceType.KING.value))
                     start_corner=(case.col * self.cell_size+taille,case.row * self.cell_size+taille)
                     end_corner=((case.col+1) * self.cell_size-taille,(case.row+1) * self.cell_size-taille)
-                    self.create_oval(start_corner,end_corner,fill='red',outline='red')
+                    self.create_oval(start_corner,end_corner,fill='red',outline='red',tags="overlay")
                     return
 
                 case KingStatus.CHECK_MATE:
@@ -243,9 +365,7 @@ class ChessBoardWidget(tk.Canvas):
         self.bind("<Button-1>", on_click)
 
 
-    def render(self):
-        self.delete("all")
-        board = LIBCHESS.get_main_chess_board().contents
+    def draw_squares(self):
         for col in range(8):
             for row in range(8):
                 start_corner = (col * self.cell_size, row * self.cell_size)
@@ -253,29 +373,35 @@ class ChessBoardWidget(tk.Canvas):
                 color = self.LIGHT_COLOR if (col + row) % 2 == 0 else self.DARK_COLOR
                 self.create_rectangle(start_corner, end_corner, fill=color, outline=color)
 
-        for col in range(8):
-            for row in range(8):
-                current_cell = Position(row,col)
-                piece_on_cell = board.get_piece_at(current_cell)
-                if (not piece_on_cell.is_empty) :
-                    pos_y = row *self.cell_size + self.cell_size / 2
-                    pos_x= col *self.cell_size + self.cell_size /2
-                    self.create_image(pos_y,pos_x, image=self.Dpieces[piece_on_cell])
+    def update_pieces(self):
+        for change in self.game.get_board_changes():
+            square = (change.position.col, change.position.row)
+            item = self.piece_items.pop(square, None)
+            if item is not None:
+                self.delete(item)
+
+            if not change.piece.is_empty:
+                pos_x = square[0] * self.cell_size + self.cell_size / 2
+                pos_y = square[1] * self.cell_size + self.cell_size / 2
+                self.piece_items[square] = self.create_image(pos_x, pos_y, image=self.Dpieces[change.piece])
 
+    # Only the move hints and messages, the pieces follow the moves
+    def render(self):
+        self.delete("overlay")
         for case in self.possible_moves:
             taille=40
             start_corner=(case.col * self.cell_size+taille,case.row * self.cell_size+taille)
             end_corner=((case.col+1) * self.cell_size-taille,(case.row+1) * self.cell_size-taille)
-            self.create_oval(start_corner,end_corner,fill='grey',outline='grey')
+            self.create_oval(start_corner,end_corner,fill='grey',outline='grey',tags="overlay")
 
 
     def show_message(self, message):
         border_length = self.cell_size * 8
         center = (border_length / 2, border_length / 2)
-        self.create_text(center, text=message, anchor="center", fill="red", font="Arial 30 bold", justify="center")
+        self.create_text(center, text=message, anchor="center", fill="red", font="Arial 30 bold", justify="center", tags="overlay")
 
     def resign(self):
-        resigned_color = PieceColor(LIBCHESS.get_color_to_play())
+        resigned_color = self.game.get_color_to_play()
         opponent_color = resigned_color.get_opposite()
         self.show_message(f"{resigned_color} resigns\n{opponent_color} wins")
         kill_timer()